@@ -146,7 +146,7 @@ int pgmWrite(char* filename, long rows,long cols,
       FILE* file;        /* pointer to the file buffer */
       int maxval;        /* maximum value in the image array */
       long nwritten = 0; /* counter for the number of pixels written */
-      long i,j;          /* for loop counters */
+      long i;            /* for loop counter */
 
       /* return 0 if the dimensions are larger than the image array. */
       if (rows > MAXROWS || cols > MAXCOLS) {
@@ -154,8 +154,9 @@ int pgmWrite(char* filename, long rows,long cols,
 	   return (0);
       }
 
-      /* open the file; write header and comments specified by the user. */
-      if ((file = fopen(filename, "w")) == NULL)	{
+      /* open the file in binary mode (text mode corrupts P5 data on
+       * Windows); write header and comments specified by the user. */
+      if ((file = fopen(filename, "wb")) == NULL)	{
            printf("ERROR: file open failed\n");
 	   return(0);
       }
@@ -172,13 +173,10 @@ int pgmWrite(char* filename, long rows,long cols,
       /* WRITE MAXIMUM VALUE TO FILE */
       fprintf(file, "%d\n", (int)255);
 
-      /* Write data */
-
-     /* for (i=0; i < rows; i++) {
-         Orig: nwritten += fwrite((void*)&(image[i][0]),sizeof(unsigned char), cols, file);}*/
- for (i=0; i < rows; i++)
- for (j=0; j < cols; j++)
-fwrite(&(image[i][j]),sizeof(unsigned char),1,file);
+      /* Write data, one row per fwrite */
+      for (i=0; i < rows; i++) {
+           nwritten += fwrite((void*)&(image[i][0]),sizeof(unsigned char), cols, file);
+      }
 
 
 
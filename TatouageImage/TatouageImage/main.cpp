@@ -15,13 +15,56 @@
 #include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <limits>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <time.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+// Ouvertures et lectures asynchrones io_uring du chargeur en lot, par les appels systme directs (liburing n'est pas ncessaire) quand les en-ttes
+// du noyau les dclarent (IORING_SETUP_CLAMP date des mmes en-ttes que OPENAT, STATX et le sondage) ; TATOUAGE_SANS_IO_URING les dsactive
+// Sans elles, ou si le noyau refuse l'anneau ou l'une de ses oprations, le chargeur garde ses threads de lecture
+#if defined(__linux__) && !defined(TATOUAGE_SANS_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register) && defined(IORING_SETUP_CLAMP)
+#define TATOUAGE_IO_URING
+#endif
+#endif
+#endif
+#endif
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <complex>
+#include <ctype.h>
 
 typedef struct {
 	unsigned char red, green, blue;
@@ -39,618 +82,6057 @@ typedef struct {
 #define MAXLENGTH 256
 #define MAXVALUE 255
 
-static PPMImage *readPPM(const char *filename)
+// Morceau de donnes  crire, pour regrouper l'en-tte et les lignes d'une image en une seule criture
+typedef struct {
+	const void *debut;
+	size_t taille;
+} MorceauEcriture;
+
+// Remplace filename par temporaire en une seule opration (sur un mme disque, un lecteur voit l'un ou l'autre fichier en entier)
+int remplacerFichier(const char *temporaire, const char *filename)
 {
-	char buff[16];
-	PPMImage *img;
+#ifdef _WIN32
+	return MoveFileExA(temporaire, filename, MOVEFILE_REPLACE_EXISTING) ? 1 : 0;
+#else
+	return rename(temporaire, filename) == 0 ? 1 : 0;
+#endif
+}
+
+// Nom d'un fichier temporaire  ct de filename, propre au processus et  l'appel (pid et compteur) : deux critures simultanes,
+// dans le mme processus ou non, n'crivent jamais dans le mme fichier temporaire
+void nomTemporaire(char *temporaire, size_t taille, const char *filename)
+{
+	static std::atomic<unsigned> compteur(0);
+#ifdef _WIN32
+	snprintf(temporaire, taille, "%s.tmp%d.%u", filename, _getpid(), compteur.fetch_add(1));
+#else
+	snprintf(temporaire, taille, "%s.tmp%d.%u", filename, (int)getpid(), compteur.fetch_add(1));
+#endif
+}
+
+// crit les morceaux dans un fichier temporaire  ct de filename puis le renomme : un lecteur voit l'ancien fichier ou le nouveau complet, jamais une image  moiti crite
+// Sous Linux les morceaux partent en un seul writev ; sous Windows ils sont rassembls dans un tampon crit en une fois
+// Renvoie 1 si le fichier a t crit, 0 sinon
+int ecritureAtomique(const char *filename, const MorceauEcriture *morceaux, int nbmorceaux)
+{
+	char temporaire[1024];
+	nomTemporaire(temporaire, sizeof(temporaire), filename);
+#ifdef _WIN32
+	size_t total = 0;
+	for (int m = 0; m < nbmorceaux; m++)
+	{
+		total += morceaux[m].taille;
+	}
+	std::vector<unsigned char> tampon(total);
+	size_t position = 0;
+	for (int m = 0; m < nbmorceaux; m++)
+	{
+		if (morceaux[m].taille > 0)
+		{
+			memcpy(&tampon[position], morceaux[m].debut, morceaux[m].taille);
+			position += morceaux[m].taille;
+		}
+	}
 	FILE *fp;
-	int c, rgb_comp_color;
-	//open PPM file for reading
-	fopen_s(&fp, filename, "rb");
-	if (!fp) {
-		fprintf(stderr, "Unable to open file '%s'\n", filename);
-		exit(1);
+	if (fopen_s(&fp, temporaire, "wb") != 0 || !fp)
+	{
+		fprintf(stderr, "Unable to open file '%s'\n", temporaire);
+		return 0;
 	}
-
-	//read image format
-	if (!fgets(buff, sizeof(buff), fp)) {
-		perror(filename);
-		exit(1);
+	bool ok = total == 0 || fwrite(&tampon[0], 1, total, fp) == total;
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok || !remplacerFichier(temporaire, filename))
+	{
+		fprintf(stderr, "Unable to write file '%s'\n", filename);
+		remove(temporaire);
+		return 0;
 	}
-
-	//check the image format
-	if (buff[0] != 'P' || buff[1] != '6') {
-		fprintf(stderr, "Invalid image format (must be 'P6')\n");
-		exit(1);
+#else
+	int fd = open(temporaire, O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Unable to open file '%s'\n", temporaire);
+		return 0;
 	}
-
-	//alloc memory form image
-	img = (PPMImage *)malloc(sizeof(PPMImage));
-	if (!img) {
-		fprintf(stderr, "Unable to allocate memory\n");
-		exit(1);
+	std::vector<struct iovec> vecteurs(nbmorceaux);
+	for (int m = 0; m < nbmorceaux; m++)
+	{
+		vecteurs[m].iov_base = (void *)morceaux[m].debut;
+		vecteurs[m].iov_len = morceaux[m].taille;
 	}
-
-	//check for comments
-	c = getc(fp);
-	while (c == '#') {
-		while (getc(fp) != '\n');
-		c = getc(fp);
+	// writev peut crire moins que demand : on reprend l o il s'est arrt
+	bool ok = true;
+	size_t premier = 0;
+	while (ok && premier < vecteurs.size())
+	{
+		int nb = (int)std::min(vecteurs.size() - premier, (size_t)IOV_MAX);
+		ssize_t ecrit = writev(fd, &vecteurs[premier], nb);
+		if (ecrit < 0)
+		{
+			ok = (errno == EINTR);
+			continue;
+		}
+		while (premier < vecteurs.size() && (size_t)ecrit >= vecteurs[premier].iov_len)
+		{
+			ecrit -= vecteurs[premier].iov_len;
+			premier++;
+		}
+		if (premier < vecteurs.size())
+		{
+			vecteurs[premier].iov_base = (char *)vecteurs[premier].iov_base + ecrit;
+			vecteurs[premier].iov_len -= ecrit;
+		}
 	}
-
-	ungetc(c, fp);
-	//read image size information
-	if (fscanf_s(fp, "%d %d", &img->x, &img->y) != 2) {
-		fprintf(stderr, "Invalid image size (error loading '%s')\n", filename);
-		exit(1);
+	ok = (close(fd) == 0) && ok;
+	if (!ok || !remplacerFichier(temporaire, filename))
+	{
+		fprintf(stderr, "Unable to write file '%s'\n", filename);
+		unlink(temporaire);
+		return 0;
 	}
+#endif
+	return 1;
+}
 
-	//read rgb component
-	if (fscanf_s(fp, "%d", &rgb_comp_color) != 1) {
-		fprintf(stderr, "Invalid rgb component (error loading '%s')\n", filename);
-		exit(1);
+// Lit taille octets  partir de position dans un fichier ouvert, sans dpendre de la position courante (pread sous Linux)
+bool lireAPosition(FILE *fp, long long position, void *dest, size_t taille)
+{
+#ifdef _WIN32
+	if (_fseeki64(fp, position, SEEK_SET) != 0)
+	{
+		return false;
 	}
-
-	//check rgb component depth
-	if (rgb_comp_color != RGB_COMPONENT_COLOR) {
-		fprintf(stderr, "'%s' does not have 8-bits components\n", filename);
-		exit(1);
+	return fread(dest, 1, taille, fp) == taille;
+#else
+	size_t lus = 0;
+	while (lus < taille)
+	{
+		ssize_t n = pread(fileno(fp), (char *)dest + lus, taille - lus, (off_t)(position + lus));
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		lus += n;
 	}
+	return true;
+#endif
+}
 
-	while (fgetc(fp) != '\n');
-	//memory allocation for pixel data
-	img->data = (PPMPixel*)malloc(img->x * img->y * sizeof(PPMPixel));
+// Taille d'un fichier ouvert, ou -1
+static long long tailleFichier(FILE *fp)
+{
+#ifdef _WIN32
+	struct _stat64 s;
+	return _fstat64(_fileno(fp), &s) == 0 ? (long long)s.st_size : -1;
+#else
+	struct stat s;
+	return fstat(fileno(fp), &s) == 0 ? (long long)s.st_size : -1;
+#endif
+}
 
-	if (!img) {
-		fprintf(stderr, "Unable to allocate memory\n");
-		exit(1);
+// Entiers des formats binaires (index des empreintes, format tuil), toujours en petit-boutiste quel que soit le processeur
+static void ecrireEntierLE(unsigned char *dest, unsigned long long valeur, int octets)
+{
+	for (int k = 0; k < octets; k++)
+	{
+		dest[k] = (unsigned char)(valeur >> (8 * k));
 	}
+}
 
-	//read pixel data from file
-	if (fread(img->data, 3 * img->x, img->y, fp) != img->y) {
-		fprintf(stderr, "Error loading image '%s'\n", filename);
-		exit(1);
+static unsigned long long lireEntierLE(const unsigned char *src, int octets)
+{
+	unsigned long long valeur = 0;
+	for (int k = octets - 1; k >= 0; k--)
+	{
+		valeur = (valeur << 8) | src[k];
 	}
-
-	fclose(fp);
-	return img;
+	return valeur;
 }
+
 void writePPM(const char *filename, PPMImage *img)
 {
-	FILE *fp;
-	//open file for output
-	fopen_s(&fp, filename, "wb");
-	if (!fp) {
-		fprintf(stderr, "Unable to open file '%s'\n", filename);
+	//format the header: image format, image size, rgb component depth
+	char entete[64];
+	int tailleentete = snprintf(entete, sizeof(entete), "P6\n%d %d\n%d\n", img->x, img->y, RGB_COMPONENT_COLOR);
+
+	//header and pixel data in one write, then atomic replacement of the file
+	MorceauEcriture morceaux[2] = { { entete, (size_t)tailleentete }, { img->data, (size_t)3 * img->x * img->y } };
+	if (!ecritureAtomique(filename, morceaux, 2)) {
 		exit(1);
 	}
-
-	//write the header file
-	//image format
-	fprintf(fp, "P6\n");
-
-	//image size
-	fprintf(fp, "%d %d\n", img->x, img->y);
-
-	// rgb component depth
-	fprintf(fp, "%d\n", RGB_COMPONENT_COLOR);
-
-	// pixel data
-	fwrite(img->data, 3 * img->x, img->y, fp);
-	fclose(fp);
 }
 
 using namespace std;
-int readPGM(string Nfile, long &rows, long &cols, unsigned char image[MAXROWS][MAXCOLS])
-{
-	ifstream f(Nfile.c_str(), std::ios_base::binary);
-	char c;
+// Codes de retour du lecteur PNM
+#define PNM_OK 0
+#define PNM_INCOMPLET 1
+#define PNM_ERREUR_OUVERTURE 2
+#define PNM_ERREUR_FORMAT 3
+#define PNM_ERREUR_ENTETE 4
+#define PNM_ERREUR_DONNEES 5
+#define PNM_ERREUR_MEMOIRE 6
+#define PNM_ERREUR_PROFONDEUR 7
 
-
-	string ligne;
-	if (f.eof())
+// Message correspondant  un code de retour du lecteur PNM
+const char *messageErreurPNM(int code)
+{
+	switch (code)
 	{
-		cout << "fichier vide";
-		return 0;
+	case PNM_OK: return "pas d'erreur";
+	case PNM_INCOMPLET: return "en-tete incomplet";
+	case PNM_ERREUR_OUVERTURE: return "impossible d'ouvrir le fichier";
+	case PNM_ERREUR_FORMAT: return "format inconnu (P1 a P7 attendus)";
+	case PNM_ERREUR_ENTETE: return "en-tete incorrect";
+	case PNM_ERREUR_DONNEES: return "donnees manquantes ou incorrectes";
+	case PNM_ERREUR_MEMOIRE: return "memoire insuffisante";
+	case PNM_ERREUR_PROFONDEUR: return "profondeur non prise en charge";
+	default: return "erreur inconnue";
 	}
-	f >> c;
+}
+
+// En-tte d'une image PNM : P1  P6 (PBM, PGM, PPM en ASCII puis en binaire) ou P7 (PAM)
+typedef struct {
+	int format;              // chiffre aprs le P, de 1  7
+	long largeur, hauteur;
+	int canaux;              // 1 pour PBM et PGM, 3 pour PPM, DEPTH pour PAM
+	int maxval;              // 1 pour PBM
+	string typetuple;        // TUPLTYPE pour PAM, vide sinon
+	long long debutdonnees;  // position du premier octet de donnes dans le fichier
+} EntetePNM;
+
+// Image PNM dcode : composantes entrelaces, ligne par ligne ; pour PBM 1 = blanc, comme en PAM
+// Les chantillons sont sur 8 bits (ImagePNM) ou sur 16 bits (ImagePNM16, pour maxval jusqu' 65535)
+template <typename T> struct ImagePNMT {
+	EntetePNM entete;
+	vector<T> donnees;
+};
+typedef ImagePNMT<unsigned char> ImagePNM;
+typedef ImagePNMT<unsigned short> ImagePNM16;
 
-	while (c == '#')
+// Copie des chantillons binaires : d'un bloc en 8 bits, octet de poids fort en premier en 16 bits (ordre des fichiers PNM)
+template <typename T> void copierEchantillonsPNM(const unsigned char *src, size_t nb, int octets, T *dest)
+{
+	if (octets == 1 && sizeof(T) == 1)
 	{
-		// Commentaire
-		getline(f, ligne);
-		f >> c;
+		memcpy(dest, src, nb);
 	}
-
-	if (c != 'P')
+	else if (octets == 1)
 	{
-		cout << "Format incorrect !" << endl;
-		return 0;
+		for (size_t n = 0; n < nb; n++)
+		{
+			dest[n] = src[n];
+		}
 	}
 	else
 	{
-		f >> c;
-		if (c != '2' && c != '5')
+		for (size_t n = 0; n < nb; n++)
 		{
-			cout << "Format incorrect!!" << endl;
-			return 0;
+			dest[n] = (T)((src[2 * n] << 8) | src[2 * n + 1]);
 		}
 	}
+}
 
-	f >> rows >> cols;
-	int nbniveauxgris;
-	f >> nbniveauxgris;
-	f >> ws;
-
-	long indice = f.tellg();
-	int compt = 0;
-	f.seekg(indice);
-	f >> image[0][0] >> ws;
+// Curseur sur un tampon : l'analyse de l'en-tte et des donnes ASCII ne fait aucune allocation
+typedef struct {
+	const unsigned char *p, *fin;
+} LecteurPNM;
 
-	indice++;
+static inline bool estBlancPNM(unsigned char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
 
-	for (long i = 0;i<rows;i++)
+// Saute les blancs et les commentaires (un # va jusqu' la fin de la ligne, o qu'il soit). Renvoie false  la fin du tampon
+static inline bool sauterBlancsPNM(LecteurPNM &l)
+{
+	while (l.p < l.fin)
 	{
-		for (long j = 0;j<cols;j++)
+		if (*l.p == '#')
+		{
+			while (l.p < l.fin && *l.p != '\n' && *l.p != '\r')
+			{
+				l.p++;
+			}
+		}
+		else if (estBlancPNM(*l.p))
 		{
-			f.seekg(indice);
-			f >> image[i][j] >> ws;
-			indice++;
+			l.p++;
+		}
+		else
+		{
+			return true;
 		}
-
 	}
-
-	return 1;
-
+	return false;
 }
 
-/* INPUT: a filename (char*), the dimensions of the pixmap (rows,cols of
-*   type long), and a pointer to a 2D array (MAXROWS x MAXCOLS) in row
-*   major order.
-* OUTPUT: an integer is returned indicating if the desired file was written
-*   (in P5 PGM format (binary)).  A 1 is returned if the write was completed
-*   and 0 if it was not.  An error message is returned if the file is not
-*   properly opened.
-*/
-int pgmWrite(char* filename, long rows, long cols,
-	unsigned char image[MAXROWS][MAXCOLS], char* comment_string) {
-	ofstream file;        /* pointer to the file buffer */
-	int maxval;        /* maximum value in the image array */
-	long nwritten = 0; /* counter for the number of pixels written */
-	long i, j;          /* for loop counters */
-
-						/* return 0 if the dimensions are larger than the image array. */
-	if (rows > MAXROWS || cols > MAXCOLS) {
-		printf("ERROR: row/col specifications larger than image array:\n");
-		return (0);
-	}
-
-	/* open the file; write header and comments specified by the user. */
-	file.open(filename);
-	if (file.fail())
+// Lit un entier positif de l'en-tte. Si le tampon s'arrte sur le nombre et que ce n'est pas la fin du fichier, il est peut-tre coup
+static int lireEntierPNM(LecteurPNM &l, bool finfichier, long &valeur)
+{
+	if (!sauterBlancsPNM(l))
 	{
-		cout << "ERROR: file open failed, incorrect file name" << endl;
-		return 0;
+		return finfichier ? PNM_ERREUR_ENTETE : PNM_INCOMPLET;
 	}
-	file << "P5\n";
-
-	if (comment_string != NULL)
+	if (*l.p < '0' || *l.p > '9')
 	{
-		file << "# " << comment_string << "\n";
+		return PNM_ERREUR_ENTETE;
 	}
-
-	/* write the dimensions of the image */
-	file << cols << " " << rows << endl;
-
-	/* NOTE: MAXIMUM VALUE IS WHITE; COLOURS ARE SCALED FROM 0 - */
-	/* MAXVALUE IN A .PGM FILE. */
-
-	/* WRITE MAXIMUM VALUE TO FILE */
-	file << (int)255 << endl;
-
-	/* Write data */
-	for (i = 0; i < rows; i++)
-		for (j = 0; j < cols; j++)
-			file << image[i][j];
-
-	file.close();
-	return(1);
-}
-
-// Utilise la mthode du patchwork (PPM) (TP1)
-void patchworkPPM(PPMImage *image, int &debutcarre1, int &debutcarre2, int &taillecarres)
-{
-	srand(time(NULL));
-	debutcarre1 = rand() % (image->x * image->y);
-	debutcarre2 = rand() % (image->x * image->y);
-	taillecarres = 30;
-	
-	for (int i = 0; i < taillecarres; i++)
+	long v = 0;
+	while (l.p < l.fin && *l.p >= '0' && *l.p <= '9')
 	{
-		for (int j = 0; j < taillecarres; j++)
+		v = v * 10 + (*l.p - '0');
+		if (v > 0x7FFFFFFFL)
 		{
-			image->data[debutcarre1 + j + i * 512].red = (unsigned char)((int)(image->data[debutcarre1 + j + i * 512].red) - 1);
-			image->data[debutcarre1 + j + i * 512].green = (unsigned char)((int)(image->data[debutcarre1 + j + i * 512].green) - 1);
-			image->data[debutcarre1 + j + i * 512].blue = (unsigned char)((int)(image->data[debutcarre1 + j + i * 512].blue) - 1);
-
-			image->data[debutcarre2 + j + i * 512].red = (unsigned char)((int)(image->data[debutcarre1 + j + i * 512].red) + 1);
-			image->data[debutcarre2 + j + i * 512].green = (unsigned char)((int)(image->data[debutcarre1 + j + i * 512].green) + 1);
-			image->data[debutcarre2 + j + i * 512].blue = (unsigned char)((int)(image->data[debutcarre1 + j + i * 512].blue) + 1);
+			return PNM_ERREUR_ENTETE;
 		}
+		l.p++;
+	}
+	if (l.p == l.fin && !finfichier)
+	{
+		return PNM_INCOMPLET;
 	}
+	valeur = v;
+	return PNM_OK;
 }
 
-// Utilise la mthode du patchwork (PGM) (TP1)
-void patchworkPGM(unsigned char image[MAXROWS][MAXCOLS], long rows, long cols, int &debutcarre1, int &debutcarre2, int &taillecarres)
+// Analyse l'en-tte PAM (P7) : lignes WIDTH, HEIGHT, DEPTH, MAXVAL, TUPLTYPE puis ENDHDR
+static int analyserEntetePAM(LecteurPNM &l, bool finfichier, EntetePNM &entete)
 {
-	srand(time(NULL));
-	debutcarre1 = rand() % (rows * cols);
-	int debutcarre1x = debutcarre1 / cols;
-	int debutcarre1y = debutcarre1 % rows;
-	debutcarre2 = rand() % (rows * cols);
-	int debutcarre2x = debutcarre2 / cols;
-	int debutcarre2y = debutcarre2 % rows;
-	taillecarres = 30;
-
-	for (int i = 0; i < taillecarres; i++)
+	long largeur = -1, hauteur = -1, profondeur = -1, maxval = -1;
+	int r;
+	while (true)
 	{
-		for (int j = 0; j < taillecarres; j++)
+		if (!sauterBlancsPNM(l))
+		{
+			return finfichier ? PNM_ERREUR_ENTETE : PNM_INCOMPLET;
+		}
+		const unsigned char *mot = l.p;
+		while (l.p < l.fin && !estBlancPNM(*l.p))
+		{
+			l.p++;
+		}
+		if (l.p == l.fin)
 		{
-			image[debutcarre1y + i][debutcarre1x + j] = (unsigned char)((int)(image[debutcarre1y + i][debutcarre1x + j]) - 1);
+			return finfichier ? PNM_ERREUR_ENTETE : PNM_INCOMPLET;
+		}
+		size_t longueur = l.p - mot;
 
-			image[debutcarre2y + i][debutcarre2x + j] = (unsigned char)((int)(image[debutcarre2y + i][debutcarre2x + j]) + 1);
+		if (longueur == 6 && memcmp(mot, "ENDHDR", 6) == 0)
+		{
+			while (l.p < l.fin && *l.p != '\n')
+			{
+				l.p++;
+			}
+			if (l.p == l.fin)
+			{
+				return finfichier ? PNM_ERREUR_ENTETE : PNM_INCOMPLET;
+			}
+			l.p++;
+			break;
+		}
+		else if (longueur == 8 && memcmp(mot, "TUPLTYPE", 8) == 0)
+		{
+			while (l.p < l.fin && (*l.p == ' ' || *l.p == '\t'))
+			{
+				l.p++;
+			}
+			const unsigned char *debut = l.p;
+			while (l.p < l.fin && *l.p != '\n' && *l.p != '\r')
+			{
+				l.p++;
+			}
+			if (l.p == l.fin)
+			{
+				return finfichier ? PNM_ERREUR_ENTETE : PNM_INCOMPLET;
+			}
+			if (!entete.typetuple.empty())
+			{
+				entete.typetuple += ' ';
+			}
+			entete.typetuple.append((const char *)debut, l.p - debut);
+		}
+		else
+		{
+			long *champ = NULL;
+			if (longueur == 5 && memcmp(mot, "WIDTH", 5) == 0)
+			{
+				champ = &largeur;
+			}
+			else if (longueur == 6 && memcmp(mot, "HEIGHT", 6) == 0)
+			{
+				champ = &hauteur;
+			}
+			else if (longueur == 5 && memcmp(mot, "DEPTH", 5) == 0)
+			{
+				champ = &profondeur;
+			}
+			else if (longueur == 6 && memcmp(mot, "MAXVAL", 6) == 0)
+			{
+				champ = &maxval;
+			}
+			else
+			{
+				return PNM_ERREUR_ENTETE;
+			}
+			if ((r = lireEntierPNM(l, finfichier, *champ)) != PNM_OK)
+			{
+				return r;
+			}
 		}
 	}
+	if (largeur < 1 || hauteur < 1 || profondeur < 1 || maxval < 1)
+	{
+		return PNM_ERREUR_ENTETE;
+	}
+	entete.largeur = largeur;
+	entete.hauteur = hauteur;
+	entete.canaux = (int)profondeur;
+	entete.maxval = (int)maxval;
+	return PNM_OK;
 }
-// alpha de la fonction de la DCT (TP1)
-double alphaDCT(int x, int N)
+
+// Analyse l'en-tte d'une image PNM au dbut d'un tampon
+// Renvoie PNM_INCOMPLET si le tampon ne contient pas tout l'en-tte et que finfichier est faux : il faut relire avec plus d'octets
+int analyserEntetePNM(const unsigned char *tampon, size_t taille, bool finfichier, EntetePNM &entete)
 {
-	if (x == 0)
+	LecteurPNM l = { tampon, tampon + taille };
+	entete.typetuple.clear();
+	if (taille < 2)
 	{
-		return 1.0 / sqrt(N);
+		return finfichier ? PNM_ERREUR_FORMAT : PNM_INCOMPLET;
 	}
-	else
+	if (tampon[0] != 'P' || tampon[1] < '1' || tampon[1] > '7')
 	{
-		return sqrt(2.0 / N);
+		return PNM_ERREUR_FORMAT;
 	}
-}
+	entete.format = tampon[1] - '0';
+	l.p += 2;
 
-// Calcule la DCT d'un bloc de 8 * 8 et renvoie le tableau qui contient les rsultats (PGM) (TP1)
-// Ne marche pas
-unsigned char dctBlocPGM(unsigned char image[MAXROWS][MAXCOLS], int starti, int startj)
-{
-	double tmp;
-	double ret = 0;
-	for (int i = starti; i < starti + 8; i++)
+	int r;
+	if (entete.format == 7)
 	{
-		tmp = 0;
-		for (int j = startj; j < startj + 8; j++)
+		if ((r = analyserEntetePAM(l, finfichier, entete)) != PNM_OK)
 		{
-			tmp += (double)image[i][j] * cos((startj * M_PI * (2.0 * i + 1.0)) / 2.0 * 8.0) * cos((starti * M_PI * (2.0 * j + 1.0)) / 2.0 * 8.0);
+			return r;
 		}
-		ret += tmp;
 	}
-	ret *= alphaDCT(starti, 8) * alphaDCT(startj, 8);
-	return (unsigned char) ret;
-}
-
-// Calcule la DCT entire et remplace l'image par celle-ci (PGM) (TP1)
-// Ne marche pas
-void dctPGM(unsigned char image[MAXROWS][MAXCOLS], long rows, long cols)
-{
-	for (int i = 0; i < rows; i)
+	else
 	{
-		for (int j = 0; j < cols; j)
+		long largeur, hauteur, maxval = 1;
+		if ((r = lireEntierPNM(l, finfichier, largeur)) != PNM_OK || (r = lireEntierPNM(l, finfichier, hauteur)) != PNM_OK)
 		{
-			image[i][j] = dctBlocPGM(image, i, j);
+			return r;
+		}
+		if (entete.format != 1 && entete.format != 4 && (r = lireEntierPNM(l, finfichier, maxval)) != PNM_OK)
+		{
+			return r;
+		}
+		// Un seul blanc spare l'en-tte des donnes
+		if (l.p == l.fin)
+		{
+			if (!finfichier)
+			{
+				return PNM_INCOMPLET;
+			}
+		}
+		else if (!estBlancPNM(*l.p))
+		{
+			return PNM_ERREUR_ENTETE;
+		}
+		else
+		{
+			l.p++;
+		}
+		if (largeur < 1 || hauteur < 1 || maxval < 1)
+		{
+			return PNM_ERREUR_ENTETE;
 		}
+		entete.largeur = largeur;
+		entete.hauteur = hauteur;
+		entete.canaux = (entete.format == 3 || entete.format == 6) ? 3 : 1;
+		entete.maxval = (int)maxval;
 	}
-	return;
+	if (entete.maxval > 65535)
+	{
+		return PNM_ERREUR_ENTETE;
+	}
+	entete.debutdonnees = l.p - tampon;
+	return PNM_OK;
 }
 
-// Calcule la DCT d'un bloc de 8 * 8 et renvoie le tableau qui contient les rsultats (PPM) (TP1)
-// Ne marche pas
-PPMPixel dctBlocPPM(PPMImage *image, int starti, int startj)
+// Dcode une image PNM complte contenue dans un tampon
+// Les corps ASCII passent par un lecteur d'entiers sans allocation, les corps binaires sont copis d'un bloc
+// Une image dont maxval dpasse 255 ne peut tre dcode que dans une ImagePNM16
+template <typename T> int decoderPNM(const unsigned char *tampon, size_t taille, ImagePNMT<T> &image)
 {
-	double tmpr;
-	double tmpg;
-	double tmpb;
-	double retr;
-	double retg;
-	double retb;
-	PPMPixel ret;
+	int r = analyserEntetePNM(tampon, taille, true, image.entete);
+	if (r != PNM_OK)
+	{
+		return r;
+	}
+	const EntetePNM &entete = image.entete;
+	if (entete.maxval > (int)numeric_limits<T>::max())
+	{
+		return PNM_ERREUR_PROFONDEUR;
+	}
+	unsigned long long nb = (unsigned long long)entete.largeur * entete.hauteur * entete.canaux;
+	if (nb > (unsigned long long)((size_t)-1))
+	{
+		return PNM_ERREUR_MEMOIRE;
+	}
+	try
+	{
+		image.donnees.resize((size_t)nb);
+	}
+	catch (const bad_alloc &)
+	{
+		return PNM_ERREUR_MEMOIRE;
+	}
+	LecteurPNM l = { tampon + entete.debutdonnees, tampon + taille };
+	T *sortie = image.donnees.empty() ? NULL : &image.donnees[0];
+	size_t reste = taille - (size_t)entete.debutdonnees;
+
+	switch (entete.format)
+	{
+	case 1:
+		// PBM ASCII : un chiffre par pixel, pas forcment spars par des blancs
+		for (size_t n = 0; n < nb; n++)
+		{
+			if (!sauterBlancsPNM(l) || (*l.p != '0' && *l.p != '1'))
+			{
+				return PNM_ERREUR_DONNEES;
+			}
+			sortie[n] = (T)('1' - *l.p);
+			l.p++;
+		}
+		break;
+	case 2:
+	case 3:
+		for (size_t n = 0; n < nb; n++)
+		{
+			// Les blancs et commentaires ne sont sauts que si l'on n'est pas dj sur un chiffre
+			if (l.p < l.fin && (*l.p < '0' || *l.p > '9') && !sauterBlancsPNM(l))
+			{
+				return PNM_ERREUR_DONNEES;
+			}
+			if (l.p == l.fin || *l.p < '0' || *l.p > '9')
+			{
+				return PNM_ERREUR_DONNEES;
+			}
+			unsigned v = 0;
+			while (l.p < l.fin && *l.p >= '0' && *l.p <= '9' && v <= 65535)
+			{
+				v = v * 10 + (*l.p - '0');
+				l.p++;
+			}
+			if (v > (unsigned)entete.maxval)
+			{
+				return PNM_ERREUR_DONNEES;
+			}
+			sortie[n] = (T)v;
+		}
+		break;
+	case 4:
+	{
+		// PBM binaire : 8 pixels par octet, chaque ligne commence sur un nouvel octet
+		size_t parligne = (entete.largeur + 7) / 8;
+		if (reste < parligne * entete.hauteur)
+		{
+			return PNM_ERREUR_DONNEES;
+		}
+		for (long i = 0; i < entete.hauteur; i++)
+		{
+			const unsigned char *ligne = l.p + i * parligne;
+			for (long j = 0; j < entete.largeur; j++)
+			{
+				sortie[i * entete.largeur + j] = (T)(((ligne[j >> 3] >> (7 - (j & 7))) & 1) ^ 1);
+			}
+		}
+		break;
+	}
+	default:
+	{
+		int octets = entete.maxval > 255 ? 2 : 1;
+		if (reste / octets < nb)
+		{
+			return PNM_ERREUR_DONNEES;
+		}
+		if (nb > 0)
+		{
+			copierEchantillonsPNM(l.p, (size_t)nb, octets, sortie);
+		}
+		break;
+	}
+	}
+	return PNM_OK;
+}
+
+// Lit et dcode une image PNM (P1  P7). Renvoie PNM_OK ou un code d'erreur, sans jamais quitter le programme
+template <typename T> int lirePNM(const char *filename, ImagePNMT<T> &image)
+{
+	FILE *fp;
+	if (fopen_s(&fp, filename, "rb") != 0 || !fp)
+	{
+		return PNM_ERREUR_OUVERTURE;
+	}
+	vector<unsigned char> tampon;
+	size_t lus = 0;
+	size_t bloc = 1 << 16;
+	try
+	{
+		while (true)
+		{
+			tampon.resize(lus + bloc);
+			size_t n = fread(&tampon[lus], 1, bloc, fp);
+			lus += n;
+			if (n < bloc)
+			{
+				break;
+			}
+			if (bloc < ((size_t)1 << 26))
+			{
+				bloc *= 2;
+			}
+		}
+	}
+	catch (const bad_alloc &)
+	{
+		fclose(fp);
+		return PNM_ERREUR_MEMOIRE;
+	}
+	fclose(fp);
+	if (lus == 0)
+	{
+		return PNM_ERREUR_FORMAT;
+	}
+	return decoderPNM(&tampon[0], lus, image);
+}
+
+// Prpare l'criture binaire d'une image PNM : P5 pour une composante, P6 pour trois, P7 sinon ; sur deux octets (poids fort en premier) si maxval dpasse 255
+// tampon (au moins 256 octets) reoit l'en-tte ; morceaux[0] pointe sur l'en-tte, morceaux[1] sur les chantillons (dans octets si une conversion est ncessaire)
+template <typename T> void encoderPNM(const ImagePNMT<T> &image, char *tampon, vector<unsigned char> &octets, MorceauEcriture morceaux[2])
+{
+	const EntetePNM &entete = image.entete;
+	int taille;
+	if (entete.canaux == 1 || entete.canaux == 3)
+	{
+		taille = snprintf(tampon, 256, "P%d\n%ld %ld\n%d\n", entete.canaux == 1 ? 5 : 6, entete.largeur, entete.hauteur, entete.maxval);
+	}
+	else
+	{
+		taille = snprintf(tampon, 256, "P7\nWIDTH %ld\nHEIGHT %ld\nDEPTH %d\nMAXVAL %d\n%s%.64s%sENDHDR\n", entete.largeur, entete.hauteur, entete.canaux, entete.maxval,
+			entete.typetuple.empty() ? "" : "TUPLTYPE ", entete.typetuple.c_str(), entete.typetuple.empty() ? "" : "\n");
+	}
+	morceaux[0].debut = tampon;
+	morceaux[0].taille = (size_t)taille;
+	morceaux[1].debut = image.donnees.empty() ? NULL : &image.donnees[0];
+	morceaux[1].taille = image.donnees.size();
+	if (sizeof(T) > 1)
+	{
+		int largeur = entete.maxval > 255 ? 2 : 1;
+		octets.resize(image.donnees.size() * largeur);
+		for (size_t n = 0; n < image.donnees.size(); n++)
+		{
+			if (largeur == 2)
+			{
+				octets[2 * n] = (unsigned char)(image.donnees[n] >> 8);
+				octets[2 * n + 1] = (unsigned char)image.donnees[n];
+			}
+			else
+			{
+				octets[n] = (unsigned char)image.donnees[n];
+			}
+		}
+		morceaux[1].debut = octets.empty() ? NULL : &octets[0];
+		morceaux[1].taille = octets.size();
+	}
+}
+
+// crit une image PNM en binaire (voir encoderPNM)
+template <typename T> int ecrirePNM(const char *filename, const ImagePNMT<T> &image)
+{
+	char tampon[256];
+	vector<unsigned char> octets;
+	MorceauEcriture morceaux[2];
+	encoderPNM(image, tampon, octets, morceaux);
+	return ecritureAtomique(filename, morceaux, 2);
+}
+
+static PPMImage *readPPM(const char *filename)
+{
+	ImagePNM pnm;
+	PPMImage *img;
+	//read and decode the file
+	int r = lirePNM(filename, pnm);
+	if (r != PNM_OK) {
+		fprintf(stderr, "Error loading image '%s' (%s)\n", filename, messageErreurPNM(r));
+		return NULL;
+	}
+
+	//check the image format
+	if (pnm.entete.canaux != 3) {
+		fprintf(stderr, "Invalid image format (must be 'P3', 'P6' or a 3 channel 'P7')\n");
+		return NULL;
+	}
+
+	//check rgb component depth
+	if (pnm.entete.maxval != RGB_COMPONENT_COLOR) {
+		fprintf(stderr, "'%s' does not have 8-bits components\n", filename);
+		return NULL;
+	}
+
+	//alloc memory form image
+	img = (PPMImage *)malloc(sizeof(PPMImage));
+	if (!img) {
+		fprintf(stderr, "Unable to allocate memory\n");
+		return NULL;
+	}
+	img->x = pnm.entete.largeur;
+	img->y = pnm.entete.hauteur;
+	img->data = (PPMPixel*)malloc(pnm.donnees.size());
+	if (!img->data) {
+		fprintf(stderr, "Unable to allocate memory\n");
+		free(img);
+		return NULL;
+	}
+	memcpy(img->data, &pnm.donnees[0], pnm.donnees.size());
+	return img;
+}
+
+// Lit une image en niveau de gris (P1, P2, P4, P5 ou P7  une composante). Renvoie 1 si l'image a t lue, 0 sinon
+int readPGM(string Nfile, long &rows, long &cols, unsigned char image[MAXROWS][MAXCOLS])
+{
+	ImagePNM pnm;
+	int r = lirePNM(Nfile.c_str(), pnm);
+	if (r != PNM_OK)
+	{
+		cout << "Erreur de lecture de " << Nfile << " : " << messageErreurPNM(r) << endl;
+		return 0;
+	}
+	if (pnm.entete.canaux != 1)
+	{
+		cout << "Format incorrect !" << endl;
+		return 0;
+	}
+	if (pnm.entete.hauteur > MAXROWS || pnm.entete.largeur > MAXCOLS)
+	{
+		cout << "Image trop grande (" << MAXROWS << " * " << MAXCOLS << " au plus)" << endl;
+		return 0;
+	}
+	rows = pnm.entete.hauteur;
+	cols = pnm.entete.largeur;
+	for (long i = 0; i < rows; i++)
+	{
+		memcpy(image[i], &pnm.donnees[i * cols], cols);
+	}
+	return 1;
+}
+
+/* INPUT: a filename (char*), the dimensions of the pixmap (rows,cols of
+*   type long), and a pointer to a 2D array (MAXROWS x MAXCOLS) in row
+*   major order.
+* OUTPUT: an integer is returned indicating if the desired file was written
+*   (in P5 PGM format (binary)).  A 1 is returned if the write was completed
+*   and 0 if it was not.  An error message is returned if the file is not
+*   properly opened.
+* NOTE: the image is written to a temporary file which then replaces
+*   filename, so a concurrent reader never sees a partially written file.
+*/
+int pgmWrite(char* filename, long rows, long cols,
+	unsigned char image[MAXROWS][MAXCOLS], char* comment_string) {
+	string entete;     /* header, formatted in memory */
+	long i;            /* for loop counter */
+
+						/* return 0 if the dimensions are larger than the image array. */
+	if (rows > MAXROWS || cols > MAXCOLS) {
+		printf("ERROR: row/col specifications larger than image array:\n");
+		return (0);
+	}
+
+	/* format the header and comments specified by the user. */
+	entete = "P5\n";
+
+	if (comment_string != NULL)
+	{
+		entete += string("# ") + comment_string + "\n";
+	}
+
+	/* the dimensions of the image */
+	entete += to_string(cols) + " " + to_string(rows) + "\n";
+
+	/* NOTE: MAXIMUM VALUE IS WHITE; COLOURS ARE SCALED FROM 0 - */
+	/* MAXVALUE IN A .PGM FILE. */
+
+	/* MAXIMUM VALUE */
+	entete += "255\n";
+
+	/* Header and rows of data in one binary write, to a temporary file renamed over filename. */
+	vector<MorceauEcriture> morceaux(rows + 1);
+	morceaux[0].debut = entete.data();
+	morceaux[0].taille = entete.size();
+	for (i = 0; i < rows; i++)
+	{
+		morceaux[i + 1].debut = &image[i][0];
+		morceaux[i + 1].taille = cols;
+	}
+	if (!ecritureAtomique(filename, &morceaux[0], (int)morceaux.size()))
+	{
+		cout << "ERROR: file write failed, incorrect file name" << endl;
+		return 0;
+	}
+	return(1);
+}
+
+// Seuil de visibilit de luminance (modle de Chou et Li) : l'oeil tolre plus de bruit dans les zones sombres et claires
+double seuilLuminance(double moyenne)
+{
+	if (moyenne <= 127.0)
+	{
+		return 17.0 * (1.0 - sqrt(moyenne / 127.0)) + 3.0;
+	}
+	else
+	{
+		return 3.0 / 128.0 * (moyenne - 127.0) + 3.0;
+	}
+}
+
+// Calcule la force de marquage de chaque pixel  partir de la moyenne et de la variance locales sur une fentre (2 * rayon + 1)
+// Deux passes : la premire construit les tables de sommes cumules (somme et somme des carrs), la seconde lit chaque fentre en 4 accs
+void carteForceLuminance(const unsigned char *lum, long rows, long cols, long pas, int rayon, int amax, unsigned char force[MAXROWS][MAXCOLS])
+{
+	long largeur = cols + 1;
+	vector<double> somme((rows + 1) * largeur, 0.0);
+	vector<double> somme2((rows + 1) * largeur, 0.0);
+
+	for (long i = 0; i < rows; i++)
+	{
+		double ligne = 0, ligne2 = 0;
+		for (long j = 0; j < cols; j++)
+		{
+			double v = lum[i * pas + j];
+			ligne += v;
+			ligne2 += v * v;
+			somme[(i + 1) * largeur + j + 1] = somme[i * largeur + j + 1] + ligne;
+			somme2[(i + 1) * largeur + j + 1] = somme2[i * largeur + j + 1] + ligne2;
+		}
+	}
+
+	for (long i = 0; i < rows; i++)
+	{
+		long i0 = i - rayon < 0 ? 0 : i - rayon;
+		long i1 = i + rayon + 1 > rows ? rows : i + rayon + 1;
+		for (long j = 0; j < cols; j++)
+		{
+			long j0 = j - rayon < 0 ? 0 : j - rayon;
+			long j1 = j + rayon + 1 > cols ? cols : j + rayon + 1;
+			double n = (double)((i1 - i0) * (j1 - j0));
+			double s = somme[i1 * largeur + j1] - somme[i0 * largeur + j1] - somme[i1 * largeur + j0] + somme[i0 * largeur + j0];
+			double s2 = somme2[i1 * largeur + j1] - somme2[i0 * largeur + j1] - somme2[i1 * largeur + j0] + somme2[i0 * largeur + j0];
+			double moyenne = s / n;
+			double variance = s2 / n - moyenne * moyenne;
+			// La texture masque aussi le marquage : on garde le plus grand des deux seuils
+			double seuil = seuilLuminance(moyenne);
+			double texture = 0.25 * sqrt(variance > 0 ? variance : 0);
+			if (texture > seuil)
+			{
+				seuil = texture;
+			}
+			int f = (int)(seuil + 0.5);
+			force[i][j] = (unsigned char)(f < 1 ? 1 : (f > amax ? amax : f));
+		}
+	}
+	return;
+}
+
+// Carte de force adaptative pour une image en niveau de gris, borne par amax (remplace la constante a choisie  la main)
+void carteForcePGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int rayon, int amax, unsigned char force[MAXROWS][MAXCOLS])
+{
+	carteForceLuminance(&im_gris[0][0], rows, cols, MAXCOLS, rayon, amax, force);
+}
+
+// Carte de force adaptative pour une image couleur, calcule sur la luminance (mme indexation que les autres fonctions PPM)
+void carteForcePPM(PPMImage *image, int rayon, int amax, unsigned char force[MAXROWS][MAXCOLS])
+{
+	if (image->x > MAXCOLS || image->y > MAXROWS)
+	{
+		cout << "Image trop grande pour la carte de force" << endl;
+		return;
+	}
+	vector<unsigned char> lum(image->x * image->y);
+	for (long p = 0; p < (long)lum.size(); p++)
+	{
+		lum[p] = (unsigned char)((77 * image->data[p].red + 150 * image->data[p].green + 29 * image->data[p].blue) >> 8);
+	}
+	carteForceLuminance(&lum[0], image->y, image->x, image->x, rayon, amax, force);
+}
+
+// Gnrateur pseudo-alatoire  compteur Philox4x32-10 : le bloc n de la cl k se calcule directement  partir de (k, n),
+// sans tat global ; chaque thread retrouve la mme suite pour une cl, quel que soit l'ordre de calcul des blocs
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// Bloc de 4 mots de 32 bits pour une cl de 64 bits et un compteur de 128 bits (compteur, flux)
+void philox4x32(unsigned long long cle, unsigned long long compteur, unsigned long long flux, unsigned sortie[4])
+{
+	unsigned c0 = (unsigned)compteur, c1 = (unsigned)(compteur >> 32), c2 = (unsigned)flux, c3 = (unsigned)(flux >> 32);
+	unsigned k0 = (unsigned)cle, k1 = (unsigned)(cle >> 32);
+	for (int tour = 0; tour < 10; tour++)
+	{
+		unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0;
+		unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2;
+		unsigned n0 = (unsigned)(p1 >> 32) ^ c1 ^ k0;
+		unsigned n2 = (unsigned)(p0 >> 32) ^ c3 ^ k1;
+		c1 = (unsigned)p1;
+		c3 = (unsigned)p0;
+		c0 = n0;
+		c2 = n2;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	sortie[0] = c0;
+	sortie[1] = c1;
+	sortie[2] = c2;
+	sortie[3] = c3;
+}
+
+// Tirage n de 64 bits pour une cl (un bloc par tirage, flux 0)
+unsigned long long aleatoire64(unsigned long long cle, unsigned long long indice)
+{
+	unsigned b[4];
+	philox4x32(cle, indice, 0, b);
+	return ((unsigned long long)b[1] << 32) | b[0];
+}
+
+// Tirage n uniforme dans [0, borne[ ; le biais du modulo sur 64 bits est infrieur  borne / 2^64
+unsigned long long aleatoireBorne(unsigned long long cle, unsigned long long indice, unsigned long long borne)
+{
+	return borne ? aleatoire64(cle, indice) % borne : 0;
+}
+
+// Remplit dest avec nb mots de 32 bits du flux donn,  partir du mot premier (4 mots par bloc)
+// Deux appels sur des tranches disjointes, depuis des threads diffrents, donnent la mme suite qu'un seul appel
+void remplirAleatoire(unsigned long long cle, unsigned long long flux, unsigned long long premier, unsigned *dest, size_t nb)
+{
+	unsigned b[4];
+	size_t n = 0;
+	unsigned long long bloc = premier / 4;
+	int decalage = (int)(premier % 4);
+	while (n < nb)
+	{
+		philox4x32(cle, bloc++, flux, b);
+		for (int m = decalage; m < 4 && n < nb; m++)
+		{
+			dest[n++] = b[m];
+		}
+		decalage = 0;
+	}
+}
+
+// Index des empreintes o enregistrer une image ds qu'elle est marque, et nom du fichier o elle sera crite
+// Les fonctions de dissimulation qui le reoivent appellent indexerPGM, indexerPPM ou indexerPNM (dfinies avec l'index, plus bas)
+typedef struct {
+	string nomindex;
+	string fichier;
+} IndexationMarquage;
+
+int indexerPGM(string nomindex, unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, string schema, string parametres, string fichier);
+int indexerPPM(string nomindex, PPMImage *image, string schema, string parametres, string fichier);
+
+// Borne une valeur de pixel dcale  [0, 255], comme dans dissimulationChaineCaracDansPGM
+static inline unsigned char bornerPixel(int tmp)
+{
+	if (tmp > 255)
+	{
+		return 255;
+	}
+	else if (tmp < 0)
+	{
+		return 0;
+	}
+	return (unsigned char)tmp;
+}
+
+// Ct des deux carrs du patchwork tirs de la cl
+#define PATCHWORK_TAILLE_CARRES 30
+
+// Tire le dbut (ligne * cols + colonne) d'un carr de taillecarres pixels de ct qui tient entirement dans l'image
+static int debutCarreAleatoire(unsigned long long cle, unsigned long long indice, long rows, long cols, int taillecarres)
+{
+	long nblignes = rows - taillecarres + 1, nbcols = cols - taillecarres + 1;
+	long n = (long)aleatoireBorne(cle, indice, (unsigned long long)nblignes * nbcols);
+	return (int)((n / nbcols) * cols + n % nbcols);
+}
+
+// Utilise la mthode du patchwork (PPM) (TP1)
+// Si une carte de force est donne, chaque pixel est dcal de sa propre force au lieu de 1
+// Les dbuts des carrs sont tirs de la cl : la mme cl redonne les mmes carrs
+void patchworkPPM(PPMImage *image, unsigned long long cle, int &debutcarre1, int &debutcarre2, int &taillecarres, unsigned char (*force)[MAXCOLS] = NULL, const IndexationMarquage *indexation = NULL)
+{
+	taillecarres = PATCHWORK_TAILLE_CARRES;
+	if (image->x < taillecarres || image->y < taillecarres || (force && (image->x > MAXCOLS || image->y > MAXROWS)))
+	{
+		cout << "Image trop petite ou trop grande pour le patchwork" << endl;
+		return;
+	}
+	debutcarre1 = debutCarreAleatoire(cle, 0, image->y, image->x, taillecarres);
+	debutcarre2 = debutCarreAleatoire(cle, 1, image->y, image->x, taillecarres);
+
+	for (int i = 0; i < taillecarres; i++)
+	{
+		for (int j = 0; j < taillecarres; j++)
+		{
+			int p1 = debutcarre1 + j + i * image->x;
+			int p2 = debutcarre2 + j + i * image->x;
+			int f1 = force ? force[p1 / image->x][p1 % image->x] : 1;
+			int f2 = force ? force[p2 / image->x][p2 % image->x] : 1;
+
+			image->data[p1].red = bornerPixel((int)(image->data[p1].red) - f1);
+			image->data[p1].green = bornerPixel((int)(image->data[p1].green) - f1);
+			image->data[p1].blue = bornerPixel((int)(image->data[p1].blue) - f1);
+
+			image->data[p2].red = bornerPixel((int)(image->data[p2].red) + f2);
+			image->data[p2].green = bornerPixel((int)(image->data[p2].green) + f2);
+			image->data[p2].blue = bornerPixel((int)(image->data[p2].blue) + f2);
+		}
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "cle=%llx debut1=%d debut2=%d taille=%d", cle, debutcarre1, debutcarre2, taillecarres);
+		indexerPPM(indexation->nomindex, image, "patchwork", parametres, indexation->fichier);
+	}
+}
+
+// Utilise la mthode du patchwork (PGM) (TP1)
+// Si une carte de force est donne, chaque pixel est dcal de sa propre force au lieu de 1
+// Les dbuts des carrs sont tirs de la cl : la mme cl redonne les mmes carrs
+void patchworkPGM(unsigned char image[MAXROWS][MAXCOLS], long rows, long cols, unsigned long long cle, int &debutcarre1, int &debutcarre2, int &taillecarres, unsigned char (*force)[MAXCOLS] = NULL, const IndexationMarquage *indexation = NULL)
+{
+	taillecarres = PATCHWORK_TAILLE_CARRES;
+	if (rows < taillecarres || cols < taillecarres)
+	{
+		cout << "Image trop petite pour le patchwork" << endl;
+		return;
+	}
+	debutcarre1 = debutCarreAleatoire(cle, 0, rows, cols, taillecarres);
+	int debutcarre1x = debutcarre1 / cols;
+	int debutcarre1y = debutcarre1 % cols;
+	debutcarre2 = debutCarreAleatoire(cle, 1, rows, cols, taillecarres);
+	int debutcarre2x = debutcarre2 / cols;
+	int debutcarre2y = debutcarre2 % cols;
+
+	for (int i = 0; i < taillecarres; i++)
+	{
+		for (int j = 0; j < taillecarres; j++)
+		{
+			int f1 = force ? force[debutcarre1x + i][debutcarre1y + j] : 1;
+			int f2 = force ? force[debutcarre2x + i][debutcarre2y + j] : 1;
+
+			image[debutcarre1x + i][debutcarre1y + j] = bornerPixel((int)(image[debutcarre1x + i][debutcarre1y + j]) - f1);
+
+			image[debutcarre2x + i][debutcarre2y + j] = bornerPixel((int)(image[debutcarre2x + i][debutcarre2y + j]) + f2);
+		}
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "cle=%llx debut1=%d debut2=%d taille=%d", cle, debutcarre1, debutcarre2, taillecarres);
+		indexerPGM(indexation->nomindex, image, rows, cols, "patchwork", parametres, indexation->fichier);
+	}
+}
+// alpha de la fonction de la DCT (TP1)
+double alphaDCT(int x, int N)
+{
+	if (x == 0)
+	{
+		return 1.0 / sqrt(N);
+	}
+	else
+	{
+		return sqrt(2.0 / N);
+	}
+}
+
+// Calcule la DCT d'un bloc de 8 * 8 et renvoie le tableau qui contient les rsultats (PGM) (TP1)
+// Ne marche pas
+unsigned char dctBlocPGM(unsigned char image[MAXROWS][MAXCOLS], int starti, int startj)
+{
+	double tmp;
+	double ret = 0;
+	for (int i = starti; i < starti + 8; i++)
+	{
+		tmp = 0;
+		for (int j = startj; j < startj + 8; j++)
+		{
+			tmp += (double)image[i][j] * cos((startj * M_PI * (2.0 * i + 1.0)) / 2.0 * 8.0) * cos((starti * M_PI * (2.0 * j + 1.0)) / 2.0 * 8.0);
+		}
+		ret += tmp;
+	}
+	ret *= alphaDCT(starti, 8) * alphaDCT(startj, 8);
+	return (unsigned char) ret;
+}
+
+// Calcule la DCT entire et remplace l'image par celle-ci (PGM) (TP1)
+// Ne marche pas
+void dctPGM(unsigned char image[MAXROWS][MAXCOLS], long rows, long cols)
+{
+	for (int i = 0; i < rows; i)
+	{
+		for (int j = 0; j < cols; j)
+		{
+			image[i][j] = dctBlocPGM(image, i, j);
+		}
+	}
+	return;
+}
+
+// Calcule la DCT d'un bloc de 8 * 8 et renvoie le tableau qui contient les rsultats (PPM) (TP1)
+// Ne marche pas
+PPMPixel dctBlocPPM(PPMImage *image, int starti, int startj)
+{
+	double tmpr;
+	double tmpg;
+	double tmpb;
+	double retr;
+	double retg;
+	double retb;
+	PPMPixel ret;
 	retr = 0;
 	retg = 0;
 	retb = 0;
 	for (int i = starti; i < starti + 8; i++)
 	{
-		tmpr = 0;
-		tmpg = 0;
-		tmpb = 0;
-		for (int j = startj; j < startj + 8; j++)
+		tmpr = 0;
+		tmpg = 0;
+		tmpb = 0;
+		for (int j = startj; j < startj + 8; j++)
+		{
+			tmpr += (double)image->data[i * image->x + j].red * cos((startj * M_PI * (2.0 * i + 1.0)) / 2.0 * 8.0) * cos((starti * M_PI * (2.0 * j + 1.0)) / 2.0 * 8.0);
+			tmpg += (double)image->data[i * image->x + j].green * cos((startj * M_PI * (2.0 * i + 1.0)) / 2.0 * 8.0) * cos((starti * M_PI * (2.0 * j + 1.0)) / 2.0 * 8.0);
+			tmpb += (double)image->data[i * image->x + j].blue * cos((startj * M_PI * (2.0 * i + 1.0)) / 2.0 * 8.0) * cos((starti * M_PI * (2.0 * j + 1.0)) / 2.0 * 8.0);
+		}
+		retr += tmpr;
+		retg += tmpg;
+		retb += tmpb;
+	}
+	retr *= alphaDCT(starti, 8) * alphaDCT(startj, 8);
+	retg *= alphaDCT(starti, 8) * alphaDCT(startj, 8);
+	retb *= alphaDCT(starti, 8) * alphaDCT(startj, 8);
+	ret.red = (unsigned char)retr;
+	ret.green = (unsigned char)retg;
+	ret.blue = (unsigned char)retb;
+	return ret;
+}
+
+// Calcule la DCT entire et remplace l'image par celle-ci (PPM) (TP1)
+// Ne marche pas
+void dctPPM(PPMImage *image)
+{
+	PPMPixel tmp;
+	for (int i = 0; i < image->x; i++)
+	{
+		for (int j = 0; j < image->y; j++)
+		{
+			tmp = dctBlocPPM(image, i, j);
+			image->data[i * image->x + j].red = tmp.red;
+			image->data[i * image->x + j].green = tmp.green;
+			image->data[i * image->x + j].blue = tmp.blue;
+		}
+	}
+	return;
+}
+
+// Dcoupage d'une valeur en morceaux de bits rpartis sur des composantes conscutives, du poids faible au poids fort :
+// avec Decoupage<3, 3, 2>, les 3 bits de poids faible vont dans la 1re composante, les 3 suivants dans la 2e et les 2 derniers dans la 3e
+// Chaque dcoupage gnre ses fonctions  la compilation, sans boucle ni test (Decoupage<4, 4>, Decoupage<1, 1, 1, 1, 1, 1, 1, 1>, ...)
+// Les composantes peuvent tre sur 8 bits (unsigned char) ou 16 bits (unsigned short)
+template <int... Bits> struct Decoupage;
+
+template <> struct Decoupage<>
+{
+	static const int nbcomposantes = 0;
+	static const int nbbits = 0;
+
+	template <int Decalage = 0, typename T> static void cacher(unsigned /*valeur*/, T * /*dest*/) {}
+	template <int Decalage = 0, typename T> static unsigned extraire(const T * /*src*/) { return 0; }
+};
+
+template <int Premier, int... Autres> struct Decoupage<Premier, Autres...>
+{
+	static const int nbcomposantes = 1 + Decoupage<Autres...>::nbcomposantes;
+	static const int nbbits = Premier + Decoupage<Autres...>::nbbits;
+	static_assert(Premier > 0 && nbbits <= 32, "Un decoupage doit tenir dans 32 bits");
+
+	// Remplace les bits de poids faible de dest[0] par les bits de valeur  partir de Decalage, puis passe  la composante suivante
+	template <int Decalage = 0, typename T> static void cacher(unsigned valeur, T *dest)
+	{
+		static_assert(Premier <= 8 * sizeof(T), "Trop de bits pour une composante");
+		const T masque = (T)((1u << Premier) - 1);
+		dest[0] = (T)((dest[0] & ~masque) | ((valeur >> Decalage) & masque));
+		Decoupage<Autres...>::template cacher<Decalage + Premier>(valeur, dest + 1);
+	}
+
+	// Reconstitue la valeur  partir des bits de poids faible des composantes
+	template <int Decalage = 0, typename T> static unsigned extraire(const T *src)
+	{
+		const T masque = (T)((1u << Premier) - 1);
+		return ((unsigned)(src[0] & masque) << Decalage) | Decoupage<Autres...>::template extraire<Decalage + Premier>(src + 1);
+	}
+};
+
+// Dcoupages utiliss par les exercices 1 et 2
+typedef Decoupage<3, 3, 2> DecoupagePGMdansPPM;
+typedef Decoupage<2, 2, 2, 2> DecoupageTexte;
+
+// Les composantes rouge, verte et bleue d'un pixel sont lues comme 3 octets conscutifs
+static_assert(sizeof(PPMPixel) == 3, "PPMPixel doit faire 3 octets");
+
+// Met les bits d'une image gris dans un pixel d'image de couleur en dcoupant un octet en 3 parties, 3, 3 et 2 qui sont mises dans les bits de poids faibles du pixel (Exercice 1)
+void dissimulationPGMdansPPM(PPMImage *im_rvb, unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, const IndexationMarquage *indexation = NULL)
+{
+	if ((rows != im_rvb->x) || (cols != im_rvb->y))
+	{
+		cout << "Erreur, les deux images ne sont pas de la meme taille. La fonction a ete annulee." << endl;
+		return;
+	}
+	for (int i = 0; i < im_rvb->x; i++)
+	{
+		for (int j = 0; j < im_rvb->y; j++)
+		{
+			DecoupagePGMdansPPM::cacher(im_gris[i][j], &im_rvb->data[i * im_rvb->x + j].red);
+		}
+	}
+	if (indexation)
+	{
+		indexerPPM(indexation->nomindex, im_rvb, "pgmdansppm", "", indexation->fichier);
+	}
+	return;
+}
+
+// Sort les bits d'une image gris  partir d'une image de couleur en rcuprant les bits de poids faibles dans les composantes de couleurs (Exercice 1)
+void extractionPGMdePPM(PPMImage *im_rvb, unsigned char im_gris[MAXROWS][MAXCOLS])
+{
+	for (int i = 0; i < im_rvb->x; i++)
+	{
+		for (int j = 0; j < im_rvb->y; j++)
+		{
+			im_gris[i][j] = (unsigned char)DecoupagePGMdansPPM::extraire(&im_rvb->data[i * im_rvb->x + j].red);
+		}
+	}
+	return;
+}
+
+// Vrai si le carr de l'exercice 2 pour nbcarac caractres et la constante k tient dans une image rows * cols
+// Le carr fait 4 * racine de ct, mais le dernier caractre d'une ligne peut en dborder de 3 pixels  droite
+bool carreTexteTient(long rows, long cols, int k, size_t nbcarac)
+{
+	double racine = sqrt((double)nbcarac);
+	if (k < 0 || k > rows - 4 * racine)
+	{
+		return false;
+	}
+	long debut = (long)(k + 2 * racine), derniere = debut;
+	for (size_t n = 1; n < nbcarac && derniere + 4 < k + 4 * racine; n++)
+	{
+		derniere += 4;
+	}
+	return derniere + DecoupageTexte::nbcomposantes <= cols;
+}
+
+// Pixels de l'exercice 2 : chaque caractre occupe 4 pixels conscutifs d'une ligne, dans le carr qui commence en (k + 2 * racine, k + 2 * racine)
+// o racine est la racine carre du nombre de caractres. positions reoit le premier pixel de chaque caractre
+// Renvoie false, aprs le message d'erreur, si le texte ne peut pas tre cach avec cette constante
+bool positionsTexteDansPGM(long rows, long cols, int k, const string &texteacacher, vector<pair<long, long> > &positions)
+{
+	positions.clear();
+	size_t nbcarac = texteacacher.size();
+	double racine = sqrt((double)nbcarac);
+	if (nbcarac > (size_t)(cols * rows) / 4)
+	{
+		cout << "Chaine de caractere trop longue par rapport a l image" << endl;
+		return false;
+	}
+	else if (k < 0)
+	{
+		cout << "Constante ne peut etre negative" << endl;
+		return false;
+	}
+	else if (k > rows - 4 * racine)
+	{
+		cout << "Constante trop grande pour rentrer toute la chaine de caractere" << endl;
+		return false;
+	}
+	else if (nbcarac == 0 || texteacacher[nbcarac - 1] != '*')
+	{
+		cout << "La chaine de caracteres doit finir par *" << endl;
+		return false;
+	}
+	else if (!carreTexteTient(rows, cols, k, nbcarac))
+	{
+		cout << "Constante trop grande pour rentrer toute la chaine de caractere" << endl;
+		return false;
+	}
+
+	long debut = (long)(k + 2 * racine);
+	for (long i = debut; i < k + 4 * racine && positions.size() < nbcarac; i++)
+	{
+		for (long j = debut; j < k + 4 * racine && positions.size() < nbcarac; j += 4)
+		{
+			positions.push_back(make_pair(i, j));
+		}
+	}
+	return true;
+}
+
+// Dissimule un texte dans une image en niveau de gris en dcoupant les bits (Exercice 2)
+void dissimulationTexteDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int k, string texteacacher, const IndexationMarquage *indexation = NULL)
+{
+	vector<pair<long, long> > positions;
+	if (!positionsTexteDansPGM(rows, cols, k, texteacacher, positions))
+	{
+		return;
+	}
+	for (size_t n = 0; n < positions.size(); n++)
+	{
+		DecoupageTexte::cacher((unsigned char)texteacacher[n], &im_gris[positions[n].first][positions[n].second]);
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "k=%d nbcarac=%d", k, (int)texteacacher.size());
+		indexerPGM(indexation->nomindex, im_gris, rows, cols, "texte", parametres, indexation->fichier);
+	}
+	return;
+}
+
+// Extrait un texte d'une image de niveau de gris (Exercice 2)
+void extractionTexteDepuisPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int k, int nbcarac, string &textearecup)
+{
+	int compteur = 0;
+	textearecup.resize(nbcarac);
+	for (int i = k + 2 * sqrt(nbcarac); i < k + 4 * sqrt(nbcarac) && compteur < nbcarac; i++)
+	{
+		for (int j = k + 2 * sqrt(nbcarac); j < k + 4 * sqrt(nbcarac) && compteur < nbcarac; j += 4)
+		{
+			textearecup[compteur] = (char)DecoupageTexte::extraire(&im_gris[i][j]);
+			compteur++;
+		}
+	}
+	return;
+}
+
+// Taille en pixels des blocs du mode dispers : l'ordre des blocs est tir de la cl, les pixels d'un bloc restent conscutifs sur une ligne
+#define BLOC_DISPERSION 64
+
+// Premiers nbutiles lments d'une permutation de [0, nbblocs[ tire de la cl (Fisher-Yates arrt aprs nbutiles changes)
+void permutationBlocs(unsigned long long cle, long nbblocs, long nbutiles, vector<long> &ordre)
+{
+	ordre.resize(nbblocs);
+	for (long n = 0; n < nbblocs; n++)
+	{
+		ordre[n] = n;
+	}
+	for (long n = 0; n < nbutiles && n < nbblocs - 1; n++)
+	{
+		long m = n + (long)aleatoireBorne(cle, n, nbblocs - n);
+		swap(ordre[n], ordre[m]);
+	}
+	ordre.resize(nbutiles < nbblocs ? nbutiles : nbblocs);
+}
+
+// Position (ligne, colonne) du premier des 4 pixels du caractre c en mode dispers
+static inline void positionDispersee(const vector<long> &ordre, long blocsparligne, long c, long &i, long &j)
+{
+	const long caracparbloc = BLOC_DISPERSION / DecoupageTexte::nbcomposantes;
+	long bloc = ordre[c / caracparbloc];
+	i = bloc / blocsparligne;
+	j = (bloc % blocsparligne) * BLOC_DISPERSION + (c % caracparbloc) * DecoupageTexte::nbcomposantes;
+}
+
+// Dissimule un texte comme l'exercice 2, mais rparti sur toute l'image selon une permutation des blocs tire de la cl
+void dissimulationTexteDisperseeDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, unsigned long long cle, string texteacacher, const IndexationMarquage *indexation = NULL)
+{
+	const long caracparbloc = BLOC_DISPERSION / DecoupageTexte::nbcomposantes;
+	long blocsparligne = cols / BLOC_DISPERSION;
+	long nbblocs = rows * blocsparligne;
+	if ((long)texteacacher.size() > nbblocs * caracparbloc)
+	{
+		cout << "Chaine de caractere trop longue par rapport a l image" << endl;
+		return;
+	}
+	else if (texteacacher.empty() || texteacacher[texteacacher.size() - 1] != '*')
+	{
+		cout << "La chaine de caracteres doit finir par *" << endl;
+		return;
+	}
+
+	vector<long> ordre;
+	permutationBlocs(cle, nbblocs, ((long)texteacacher.size() + caracparbloc - 1) / caracparbloc, ordre);
+	for (long c = 0; c < (long)texteacacher.size(); c++)
+	{
+		long i, j;
+		positionDispersee(ordre, blocsparligne, c, i, j);
+		DecoupageTexte::cacher((unsigned char)texteacacher[c], &im_gris[i][j]);
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "cle=%llx nbcarac=%d", cle, (int)texteacacher.size());
+		indexerPGM(indexation->nomindex, im_gris, rows, cols, "texte-disperse", parametres, indexation->fichier);
+	}
+}
+
+// Extrait un texte dissimul en mode dispers avec la mme cl
+void extractionTexteDisperseeDepuisPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, unsigned long long cle, int nbcarac, string &textearecup)
+{
+	const long caracparbloc = BLOC_DISPERSION / DecoupageTexte::nbcomposantes;
+	long blocsparligne = cols / BLOC_DISPERSION;
+	long nbblocs = rows * blocsparligne;
+	if (nbcarac < 0 || nbcarac > nbblocs * caracparbloc)
+	{
+		nbcarac = (int)(nbblocs * caracparbloc);
+	}
+
+	vector<long> ordre;
+	permutationBlocs(cle, nbblocs, (nbcarac + caracparbloc - 1) / caracparbloc, ordre);
+	textearecup.resize(nbcarac);
+	for (long c = 0; c < nbcarac; c++)
+	{
+		long i, j;
+		positionDispersee(ordre, blocsparligne, c, i, j);
+		textearecup[c] = (char)DecoupageTexte::extraire(&im_gris[i][j]);
+	}
+}
+
+// Fonction qui renvoie 1 si le bit du caractre est gal  1 et -1 s'il est gal  0 (Exercice 3)
+int wByte(int x, const string &texte)
+{
+	int entier = x / 8;
+	int reste = x % 8;
+	unsigned char tmp = texte[entier];
+	tmp = tmp >> (7 - reste);
+	tmp = tmp << 7;
+	if (tmp == (unsigned char)128)
+	{
+		return 1;
+	}
+	else
+	{
+		return -1;
+	}
+}
+
+// Dissimule une chaine de 8 caractres dans une image de niveau de gris (Exercice 3)
+// Avec une carte de force (carteForcePGM), a est ignor et chaque pixel utilise sa propre force ; l'extraction se fait alors avec a = 1
+void dissimulationChaineCaracDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int a, int x, int y, string texteacacher, unsigned char (*force)[MAXCOLS] = NULL, const IndexationMarquage *indexation = NULL)
+{
+	if (x + 8 >= cols || y + 8 >= rows)
+	{
+		cout << "Debut du carre trop loin par rapport  la taille de l'image" << endl;
+		return;
+	}
+	else if (x < 0 || y < 0)
+	{
+		cout << "En dehors de l'image" << endl;
+		return;
+	}
+	if (a == 0 && force == NULL)
+	{
+		cout << "Constante ne doit pas etre nulle" << endl;
+		return;
+	}
+
+	int tmp;
+	for (int i = x; i < x + 8; i++)
+	{
+		for (int j = y; j < y + 8; j++)
+		{
+			tmp = (im_gris[i][j] + (force ? force[i][j] : a) * wByte((i - x) * 8 + (j - y), texteacacher));
+			if (tmp > 255)
+			{
+				im_gris[i][j] = 255;
+			}
+			else if (tmp < 0)
+			{
+				im_gris[i][j] = 0;
+			}
+			else
+			{
+				im_gris[i][j] = tmp;
+			}
+		}
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "a=%d x=%d y=%d adaptatif=%d", a, x, y, force ? 1 : 0);
+		indexerPGM(indexation->nomindex, im_gris, rows, cols, "chaine8", parametres, indexation->fichier);
+	}
+	return;
+}
+
+// Extrait une chaine de 8 caractres cache dans une image  partir de l'image originale et de la nouvelle image (Exercice 3)
+void extractionChaineCaracDansPGM(unsigned char im_gris_orig[MAXROWS][MAXCOLS], unsigned char im_gris_modif[MAXROWS][MAXCOLS], long rows, long cols, int a, int x, int y, string &textearecup)
+{
+	if (x + 8 >= cols || y + 8 >= rows)
+	{
+		cout << "Debut du carre trop loin par rapport  la taille de l'image" << endl;
+		return;
+	}
+	else if (x < 0 || y < 0)
+	{
+		cout << "En dehors de l'image" << endl;
+		return;
+	}
+
+	int tmp;
+	unsigned char tmpbit, tmptot;
+	textearecup.resize(8);
+
+	for (int i = x; i < x + 8; i++)
+	{
+		tmptot = (unsigned char)0;
+		for (int j = y; j < y + 8; j++)
+		{
+			tmp = (int) ((im_gris_modif[i][j] - im_gris_orig[i][j]) / a);
+			if (tmp < 0)
+			{
+				tmpbit = (unsigned char)0;
+			}
+			else
+			{
+				tmpbit = (unsigned char)1;
+			}
+			tmpbit = tmpbit << (7 - (j - y));
+			tmptot = tmptot | tmpbit;
+		}
+		textearecup[i - x] = tmptot;
+	}
+	return;
+}
+
+// Dissimule un texte de faon rversible par dcalage d'histogramme : aucune copie de l'image originale n'est ncessaire pour la restaurer
+// Les pixels entre le pic de l'histogramme et un niveau vide sont dcals d'un cran, puis les pixels du pic portent chacun un bit
+// pic et zero sont renvoys et servent de cl pour l'extraction. Renvoie 1 si le texte a t cach, 0 sinon
+int dissimulationReversibleDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, string texteacacher, int &pic, int &zero, const IndexationMarquage *indexation = NULL)
+{
+	if (texteacacher.size() == 0 || texteacacher[texteacacher.size() - 1] != '*')
+	{
+		cout << "La chaine de caracteres doit finir par *" << endl;
+		return 0;
+	}
+
+	// Histogramme en une passe, sur 4 tableaux pour ne pas enchaner les critures sur la mme case
+	long histo[4][256] = { { 0 } };
+	for (long i = 0; i < rows; i++)
+	{
+		long j = 0;
+		for (; j + 4 <= cols; j += 4)
+		{
+			histo[0][im_gris[i][j]]++;
+			histo[1][im_gris[i][j + 1]]++;
+			histo[2][im_gris[i][j + 2]]++;
+			histo[3][im_gris[i][j + 3]]++;
+		}
+		for (; j < cols; j++)
+		{
+			histo[0][im_gris[i][j]]++;
+		}
+	}
+	long total[256];
+	pic = 0;
+	for (int v = 0; v < 256; v++)
+	{
+		total[v] = histo[0][v] + histo[1][v] + histo[2][v] + histo[3][v];
+		if (total[v] > total[pic])
+		{
+			pic = v;
+		}
+	}
+
+	// Niveau vide le plus proche du pic
+	zero = -1;
+	for (int e = 1; e < 256 && zero < 0; e++)
+	{
+		if (pic + e < 256 && total[pic + e] == 0)
+		{
+			zero = pic + e;
+		}
+		else if (pic - e >= 0 && total[pic - e] == 0)
+		{
+			zero = pic - e;
+		}
+	}
+	if (zero < 0)
+	{
+		cout << "Aucun niveau de gris vide dans l'image, dissimulation reversible impossible" << endl;
+		return 0;
+	}
+	if ((long)texteacacher.size() * 8 > total[pic])
+	{
+		cout << "Chaine de caractere trop longue par rapport a l image (" << total[pic] / 8 << " caracteres au plus)" << endl;
+		return 0;
+	}
+
+	// Bits du texte, poids fort en premier, dplis une fois pour toutes (plus une case  0 lue sans effet une fois le texte fini)
+	long nbbits = (long)texteacacher.size() * 8;
+	vector<unsigned char> bits(nbbits + 1, 0);
+	for (long b = 0; b < nbbits; b++)
+	{
+		bits[b] = ((unsigned char)texteacacher[b / 8] >> (7 - b % 8)) & 1;
+	}
+
+	// Une seule passe ligne par ligne, sans branchement : d'abord le dcalage des niveaux strictement entre le pic et le zro (vectoris
+	// par le compilateur), puis sur la mme ligne encore en cache chaque pixel du pic porte un bit : 0 le laisse au pic, 1 le dcale vers le zro
+	int d = zero > pic ? 1 : -1;
+	int bas = d > 0 ? pic : zero;
+	int haut = d > 0 ? zero : pic;
+	long bit = 0;
+	for (long i = 0; i < rows; i++)
+	{
+		unsigned char *ligne = im_gris[i];
+		for (long j = 0; j < cols; j++)
+		{
+			int v = ligne[j];
+			ligne[j] = (unsigned char)(v + d * ((v > bas) & (v < haut)));
+		}
+		for (long j = 0; j < cols && bit < nbbits; j++)
+		{
+			int porte = ligne[j] == pic;
+			ligne[j] = (unsigned char)(ligne[j] + d * (porte & bits[bit]));
+			bit += porte;
+		}
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "pic=%d zero=%d", pic, zero);
+		indexerPGM(indexation->nomindex, im_gris, rows, cols, "reversible", parametres, indexation->fichier);
+	}
+	return 1;
+}
+
+// Extrait le texte cach par dissimulationReversibleDansPGM et restaure exactement l'image originale
+void extractionReversibleDepuisPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int pic, int zero, string &textearecup)
+{
+	int d = zero > pic ? 1 : -1;
+	unsigned char marque = (unsigned char)(pic + d);
+	unsigned char carac = 0;
+	int nbbits = 0;
+	bool fini = false;
+	textearecup.clear();
+
+	// Lecture des bits jusqu'au caractre de fin *
+	for (long i = 0; i < rows && !fini; i++)
+	{
+		for (long j = 0; j < cols && !fini; j++)
+		{
+			if (im_gris[i][j] == pic || im_gris[i][j] == marque)
+			{
+				carac = (unsigned char)((carac << 1) | (im_gris[i][j] == marque));
+				nbbits++;
+				if (nbbits == 8)
+				{
+					textearecup += (char)carac;
+					fini = (carac == '*');
+					carac = 0;
+					nbbits = 0;
+				}
+			}
+		}
+	}
+
+	// Restauration : tous les niveaux entre pic + d et zro (inclus) reviennent d'un cran, en une passe vectorisable
+	int bas = d > 0 ? pic + 1 : zero;
+	int haut = d > 0 ? zero : pic - 1;
+	for (long i = 0; i < rows; i++)
+	{
+		unsigned char *ligne = im_gris[i];
+		for (long j = 0; j < cols; j++)
+		{
+			int v = ligne[j];
+			ligne[j] = (unsigned char)(v - d * ((v >= bas) & (v <= haut)));
+		}
+	}
+	return;
+}
+
+// Rsultat d'un essai de paramtres pour extractionTexteDepuisPGM
+typedef struct {
+	int k, nbcarac;
+	double score;
+	string texte;
+} CandidatTexte;
+
+// Note la plausibilit d'un texte extrait : 0 s'il ne finit pas par un seul *, sinon la proportion de caractres imprimables
+// Un texte court peut tre imprimable par hasard, donc le score n'atteint 1 qu' partir de 12 caractres avant le *
+// verification (facultative) permet d'exiger en plus une somme de contrle sur le texte
+double plausibiliteTexte(const string &texte, bool(*verification)(const string &) = NULL)
+{
+	if (texte.size() == 0 || texte[texte.size() - 1] != '*' || texte.find('*') != texte.size() - 1)
+	{
+		return 0;
+	}
+	if (verification != NULL && !verification(texte))
+	{
+		return 0;
+	}
+	if (texte.size() == 1)
+	{
+		return 0;
+	}
+	long imprimables = 0;
+	for (size_t c = 0; c + 1 < texte.size(); c++)
+	{
+		unsigned char u = (unsigned char)texte[c];
+		if (u >= 32 && u < 127)
+		{
+			imprimables++;
+		}
+	}
+	double longueur = (texte.size() - 1) / 12.0;
+	return (double)imprimables / (double)(texte.size() - 1) * (longueur < 1 ? longueur : 1);
+}
+
+// Lit uniquement le dernier caractre que lirait extractionTexteDepuisPGM(k, nbcarac), pour carter un essai sans tout extraire
+// Renvoie -1 si ce caractre ou le carr tombent hors de l'image
+int dernierCaracTexteDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int k, int nbcarac)
+{
+	double fin = k + 4 * sqrt(nbcarac);
+	int debut = (int)(k + 2 * sqrt(nbcarac));
+	if (fin > rows || (int)ceil(fin) + 3 > cols)
+	{
+		return -1;
+	}
+	int parligne = 0;
+	for (int j = debut; j < fin; j += 4)
+	{
+		parligne++;
+	}
+	if (parligne == 0)
+	{
+		return -1;
+	}
+	int i = debut + (nbcarac - 1) / parligne;
+	int j = debut + 4 * ((nbcarac - 1) % parligne);
+	if (i >= fin)
+	{
+		return -1;
+	}
+	return (int)DecoupageTexte::extraire(&im_gris[i][j]);
+}
+
+// Cherche k et le nombre de caractres d'un texte cach par dissimulationTexteDansPGM quand ils sont perdus
+// Les essais (k de kmin  kmax, longueur de nmin  nmax, -1 pour tout) sont rpartis sur nbthreads threads qui lisent la mme image
+// La recherche s'arrte ds qu'un essai atteint le score seuil ; les candidats trouvs sont tris du plus plausible au moins plausible
+int balayageTexteDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int kmin, int kmax, int nmin, int nmax, int nbthreads, double seuil, vector<CandidatTexte> &candidats, bool(*verification)(const string &) = NULL)
+{
+	if (kmin < 0)
+	{
+		kmin = 0;
+	}
+	if (kmax < 0 || kmax > rows)
+	{
+		kmax = rows;
+	}
+	if (nmin < 1)
+	{
+		nmin = 1;
+	}
+	if (nmax < 0 || nmax > (cols * rows) / 4)
+	{
+		nmax = (cols * rows) / 4;
+	}
+	if (nbthreads <= 0)
+	{
+		nbthreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	}
+	candidats.clear();
+	if (kmax < kmin || nmax < nmin)
+	{
+		return 0;
+	}
+
+	long long nbk = kmax - kmin + 1;
+	long long nbessais = nbk * (nmax - nmin + 1);
+	atomic<long long> prochain(0);
+	atomic<bool> trouve(false);
+	mutex verrou;
+
+	auto travail = [&]()
+	{
+		string texte;
+		long long e;
+		while (!trouve.load(memory_order_relaxed) && (e = prochain.fetch_add(1)) < nbessais)
+		{
+			int nbcarac = nmin + (int)(e / nbk);
+			int k = kmin + (int)(e % nbk);
+			if (dernierCaracTexteDansPGM(im_gris, rows, cols, k, nbcarac) != '*')
+			{
+				continue;
+			}
+			extractionTexteDepuisPGM(im_gris, rows, cols, k, nbcarac, texte);
+			double score = plausibiliteTexte(texte, verification);
+			if (score > 0)
+			{
+				lock_guard<mutex> garde(verrou);
+				CandidatTexte candidat = { k, nbcarac, score, texte };
+				candidats.push_back(candidat);
+				if (score >= seuil)
+				{
+					trouve = true;
+				}
+			}
+		}
+	};
+
+	vector<thread> threads;
+	for (int t = 1; t < nbthreads; t++)
+	{
+		threads.push_back(thread(travail));
+	}
+	travail();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+
+	sort(candidats.begin(), candidats.end(), [](const CandidatTexte &a, const CandidatTexte &b) { return a.score > b.score; });
+	return (int)candidats.size();
+}
+
+// Nombre de bits  1 d'un mot de 64 bits (mthode SWAR, sans instruction particulire)
+int nbBitsUn(unsigned long long x)
+{
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+// Distance de Hamming entre deux empreintes
+int distanceEmpreintes(unsigned long long a, unsigned long long b)
+{
+	return nbBitsUn(a ^ b);
+}
+
+// Empreinte perceptuelle sur 64 bits d'un plan de luminance : rduction  32 * 32 par moyenne, DCT 32 * 32,
+// puis un bit par coefficient basse frquence 8 * 8 (sauf la composante continue) selon qu'il dpasse la mdiane
+unsigned long long empreinteLuminance(const unsigned char *lum, long rows, long cols, long pas)
+{
+	// Table des cosinus de la DCT, calcule une seule fois (l'initialisation d'une variable statique locale est sre entre threads)
+	static double cosinus[8][32];
+	static const bool initialise = []()
+	{
+		for (int u = 0; u < 8; u++)
+		{
+			for (int x = 0; x < 32; x++)
+			{
+				cosinus[u][x] = alphaDCT(u, 32) * cos((2.0 * x + 1.0) * u * M_PI / 64.0);
+			}
+		}
+		return true;
+	}();
+	(void)initialise;
+
+	double reduite[32][32];
+	for (int bi = 0; bi < 32; bi++)
+	{
+		long i0 = bi * rows / 32, i1 = (bi + 1) * rows / 32;
+		if (i1 == i0)
+		{
+			i1 = i0 + 1;
+		}
+		for (int bj = 0; bj < 32; bj++)
+		{
+			long j0 = bj * cols / 32, j1 = (bj + 1) * cols / 32;
+			if (j1 == j0)
+			{
+				j1 = j0 + 1;
+			}
+			long somme = 0;
+			for (long i = i0; i < i1; i++)
+			{
+				for (long j = j0; j < j1; j++)
+				{
+					somme += lum[i * pas + j];
+				}
+			}
+			reduite[bi][bj] = (double)somme / (double)((i1 - i0) * (j1 - j0));
+		}
+	}
+
+	// DCT sparable, limite aux 8 * 8 coefficients utiles
+	double lignes[32][8];
+	for (int x = 0; x < 32; x++)
+	{
+		for (int v = 0; v < 8; v++)
+		{
+			double s = 0;
+			for (int y = 0; y < 32; y++)
+			{
+				s += reduite[x][y] * cosinus[v][y];
+			}
+			lignes[x][v] = s;
+		}
+	}
+	double coef[64];
+	for (int u = 0; u < 8; u++)
+	{
+		for (int v = 0; v < 8; v++)
+		{
+			double s = 0;
+			for (int x = 0; x < 32; x++)
+			{
+				s += lignes[x][v] * cosinus[u][x];
+			}
+			coef[u * 8 + v] = s;
+		}
+	}
+
+	double tri[63];
+	for (int c = 1; c < 64; c++)
+	{
+		tri[c - 1] = coef[c];
+	}
+	nth_element(tri, tri + 31, tri + 63);
+	double mediane = tri[31];
+
+	unsigned long long empreinte = 0;
+	for (int c = 1; c < 64; c++)
+	{
+		if (coef[c] > mediane)
+		{
+			empreinte |= 1ULL << (c - 1);
+		}
+	}
+	return empreinte;
+}
+
+// Empreinte perceptuelle d'une image en niveau de gris
+unsigned long long empreintePGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols)
+{
+	return empreinteLuminance(&im_gris[0][0], rows, cols, MAXCOLS);
+}
+
+// Empreinte perceptuelle d'une image couleur, calcule sur la luminance
+unsigned long long empreintePPM(PPMImage *image)
+{
+	vector<unsigned char> lum(image->x * image->y);
+	for (long p = 0; p < (long)lum.size(); p++)
+	{
+		lum[p] = (unsigned char)((77 * image->data[p].red + 150 * image->data[p].green + 29 * image->data[p].blue) >> 8);
+	}
+	return empreinteLuminance(&lum[0], image->y, image->x, image->x);
+}
+
+// Une image marque : son empreinte, la mthode et les paramtres (cl) utiliss pour la marquer
+typedef struct {
+	unsigned long long empreinte;
+	string schema, parametres, fichier;
+} EntreeEmpreinte;
+
+// Index des empreintes sur disque, par hachage multi-index : l'empreinte est coupe en 4 morceaux de 16 bits et chaque morceau a sa table,
+// o les entres sont ranges par valeur du morceau. Deux empreintes  distance au plus d ont au moins un morceau  distance au plus d / 4 :
+// une recherche ne lit donc que les cases voisines de chaque morceau, par lectures positionnes, sans charger ni reconstruire l'index
+// Fichier : "TATEMP01", nombre d'entres et taille des mtadonnes (8 octets chacun), pour chaque table 65537 dbuts de case (4 octets),
+// pour chaque table les entres de 20 octets (empreinte, position et longueur des mtadonnes), puis les mtadonnes (mthode, paramtres
+// et fichier spars par des tabulations). Les nouvelles empreintes vont d'abord dans un journal texte (nomindex.journal), fusionn dans
+// l'index ds qu'il dpasse le seizime de sa taille
+#define EMPREINTES_NBTABLES 4
+#define EMPREINTES_NBCASES 65536
+#define EMPREINTES_TAILLE_ENTETE 24
+#define EMPREINTES_TAILLE_ENTREE 20
+#define EMPREINTES_JOURNAL_MIN (256 * 1024)
+
+static inline unsigned morceauEmpreinte(unsigned long long empreinte, int table)
+{
+	return (unsigned)(empreinte >> (16 * table)) & 0xFFFF;
+}
+
+// Position des dbuts de case d'une table et des entres d'une table
+static inline long long positionCasesEmpreintes(int table)
+{
+	return EMPREINTES_TAILLE_ENTETE + (long long)table * (EMPREINTES_NBCASES + 1) * 4;
+}
+
+static inline long long positionEntreesEmpreintes(unsigned long long nb, int table)
+{
+	return positionCasesEmpreintes(EMPREINTES_NBTABLES) + ((long long)table * nb) * EMPREINTES_TAILLE_ENTREE;
+}
+
+// Ligne du journal : empreinte en hexadcimal, mthode, paramtres et fichier spars par des tabulations
+static bool lireLigneEmpreinte(const string &ligne, EntreeEmpreinte &entree)
+{
+	size_t t1 = ligne.find('\t');
+	size_t t2 = t1 == string::npos ? t1 : ligne.find('\t', t1 + 1);
+	size_t t3 = t2 == string::npos ? t2 : ligne.find('\t', t2 + 1);
+	if (t3 == string::npos)
+	{
+		return false;
+	}
+	entree.empreinte = strtoull(ligne.substr(0, t1).c_str(), NULL, 16);
+	entree.schema = ligne.substr(t1 + 1, t2 - t1 - 1);
+	entree.parametres = ligne.substr(t2 + 1, t3 - t2 - 1);
+	entree.fichier = ligne.substr(t3 + 1);
+	return true;
+}
+
+// Ajoute  entrees les lignes d'un journal (rien s'il n'existe pas)
+static void lireJournalEmpreintes(string nomjournal, vector<EntreeEmpreinte> &entrees)
+{
+	ifstream f(nomjournal.c_str());
+	string ligne;
+	while (f.good() && getline(f, ligne))
+	{
+		EntreeEmpreinte entree;
+		if (ligne.empty() || ligne[0] == '#')
+		{
+			continue;
+		}
+		if (lireLigneEmpreinte(ligne, entree))
+		{
+			entrees.push_back(entree);
+		}
+		else
+		{
+			cout << "Ligne d'index incorrecte : " << ligne << endl;
+		}
+	}
+}
+
+// Ouvre l'index et vrifie son en-tte contre la taille du fichier. Renvoie NULL si l'index n'existe pas ou est incorrect
+static FILE *ouvrirIndexEmpreintes(string nomindex, unsigned long long &nb, unsigned long long &taillemeta)
+{
+	FILE *fp;
+	if (fopen_s(&fp, nomindex.c_str(), "rb") != 0 || !fp)
+	{
+		return NULL;
+	}
+	unsigned char entete[EMPREINTES_TAILLE_ENTETE];
+	long long taille = tailleFichier(fp);
+	bool ok = taille >= EMPREINTES_TAILLE_ENTETE && lireAPosition(fp, 0, entete, sizeof(entete)) && memcmp(entete, "TATEMP01", 8) == 0;
+	if (ok)
+	{
+		nb = lireEntierLE(entete + 8, 8);
+		taillemeta = lireEntierLE(entete + 16, 8);
+		ok = nb <= 0xFFFFFFFFULL && taillemeta <= (unsigned long long)taille
+			&& (unsigned long long)positionEntreesEmpreintes(nb, EMPREINTES_NBTABLES) + taillemeta == (unsigned long long)taille;
+	}
+	if (!ok)
+	{
+		cout << "Index incorrect " << nomindex << endl;
+		fclose(fp);
+		return NULL;
+	}
+	return fp;
+}
+
+// Charge toutes les entres de l'index (pour la fusion du journal uniquement, les recherches n'en ont pas besoin)
+static int lireToutIndexEmpreintes(string nomindex, vector<EntreeEmpreinte> &entrees)
+{
+	unsigned long long nb, taillemeta;
+	FILE *fp = ouvrirIndexEmpreintes(nomindex, nb, taillemeta);
+	if (!fp)
+	{
+		return 0;
+	}
+	vector<unsigned char> brutes((size_t)nb * EMPREINTES_TAILLE_ENTREE + 1), meta((size_t)taillemeta + 1);
+	bool ok = lireAPosition(fp, positionEntreesEmpreintes(nb, 0), &brutes[0], (size_t)nb * EMPREINTES_TAILLE_ENTREE)
+		&& lireAPosition(fp, positionEntreesEmpreintes(nb, EMPREINTES_NBTABLES), &meta[0], (size_t)taillemeta);
+	fclose(fp);
+	for (unsigned long long n = 0; ok && n < nb; n++)
+	{
+		const unsigned char *e = &brutes[(size_t)n * EMPREINTES_TAILLE_ENTREE];
+		unsigned long long position = lireEntierLE(e + 8, 8), longueur = lireEntierLE(e + 16, 4);
+		ok = position + longueur <= taillemeta;
+		EntreeEmpreinte entree;
+		if (ok && lireLigneEmpreinte(string("0\t") + string((const char *)&meta[(size_t)position], (size_t)longueur), entree))
+		{
+			entree.empreinte = lireEntierLE(e, 8);
+			entrees.push_back(entree);
+		}
+	}
+	return ok ? 1 : 0;
+}
+
+// crit l'index complet (remplacement atomique du fichier)
+static int ecrireIndexEmpreintes(string nomindex, const vector<EntreeEmpreinte> &entrees)
+{
+	unsigned long long nb = entrees.size();
+	string meta;
+	vector<unsigned long long> positions(entrees.size());
+	for (size_t n = 0; n < entrees.size(); n++)
+	{
+		positions[n] = meta.size();
+		meta += entrees[n].schema + '\t' + entrees[n].parametres + '\t' + entrees[n].fichier;
+	}
+
+	vector<unsigned char> entete(EMPREINTES_TAILLE_ENTETE);
+	memcpy(&entete[0], "TATEMP01", 8);
+	ecrireEntierLE(&entete[8], nb, 8);
+	ecrireEntierLE(&entete[16], meta.size(), 8);
+	vector<unsigned char> cases((size_t)EMPREINTES_NBTABLES * (EMPREINTES_NBCASES + 1) * 4);
+	vector<unsigned char> tables((size_t)EMPREINTES_NBTABLES * nb * EMPREINTES_TAILLE_ENTREE + 1);
+	vector<size_t> ordre(entrees.size());
+	for (int t = 0; t < EMPREINTES_NBTABLES; t++)
+	{
+		// Tri des entres par valeur du morceau t, puis dbuts de case
+		for (size_t n = 0; n < ordre.size(); n++)
+		{
+			ordre[n] = n;
+		}
+		stable_sort(ordre.begin(), ordre.end(), [&](size_t a, size_t b) { return morceauEmpreinte(entrees[a].empreinte, t) < morceauEmpreinte(entrees[b].empreinte, t); });
+		size_t n = 0;
+		for (unsigned v = 0; v <= EMPREINTES_NBCASES; v++)
+		{
+			while (n < ordre.size() && morceauEmpreinte(entrees[ordre[n]].empreinte, t) < v)
+			{
+				n++;
+			}
+			ecrireEntierLE(&cases[((size_t)t * (EMPREINTES_NBCASES + 1) + v) * 4], n, 4);
+		}
+		for (size_t k = 0; k < ordre.size(); k++)
+		{
+			const EntreeEmpreinte &e = entrees[ordre[k]];
+			unsigned char *dest = &tables[((size_t)t * nb + k) * EMPREINTES_TAILLE_ENTREE];
+			ecrireEntierLE(dest, e.empreinte, 8);
+			ecrireEntierLE(dest + 8, positions[ordre[k]], 8);
+			ecrireEntierLE(dest + 16, e.schema.size() + e.parametres.size() + e.fichier.size() + 2, 4);
+		}
+	}
+	MorceauEcriture morceaux[4] = { { &entete[0], entete.size() }, { &cases[0], cases.size() }, { &tables[0], tables.size() - 1 }, { meta.data(), meta.size() } };
+	return ecritureAtomique(nomindex.c_str(), morceaux, 4);
+}
+
+// Fusionne le journal dans l'index. Le journal est d'abord renomm, pour que les enregistrements faits pendant la fusion aillent dans un nouveau journal
+int fusionnerIndexEmpreintes(string nomindex)
+{
+	string journal = nomindex + ".journal", fusion = nomindex + ".fusion";
+	FILE *fp;
+	if (fopen_s(&fp, fusion.c_str(), "rb") == 0 && fp)
+	{
+		// Reste d'une fusion interrompue : il est repris tel quel
+		fclose(fp);
+	}
+	else if (rename(journal.c_str(), fusion.c_str()) != 0)
+	{
+		return 1;
+	}
+	vector<EntreeEmpreinte> entrees;
+	if (fopen_s(&fp, nomindex.c_str(), "rb") == 0 && fp)
+	{
+		fclose(fp);
+		if (!lireToutIndexEmpreintes(nomindex, entrees))
+		{
+			return 0;
+		}
+	}
+	lireJournalEmpreintes(fusion, entrees);
+	if (!ecrireIndexEmpreintes(nomindex, entrees))
+	{
+		return 0;
+	}
+	remove(fusion.c_str());
+	return 1;
+}
+
+// Ajoute l'empreinte d'une image qui vient d'tre marque au journal de l'index, puis fusionne le journal s'il est devenu trop grand
+int enregistrerEmpreinte(string nomindex, const EntreeEmpreinte &entree)
+{
+	string journal = nomindex + ".journal";
+	long long taillejournal;
+	{
+		ofstream f(journal.c_str(), ios::app);
+		if (f.fail())
+		{
+			cout << "Impossible d'ouvrir l'index " << journal << endl;
+			return 0;
+		}
+		f << hex << setw(16) << setfill('0') << entree.empreinte << dec << '\t' << entree.schema << '\t' << entree.parametres << '\t' << entree.fichier << '\n';
+		taillejournal = (long long)f.tellp();
+		if (f.fail())
+		{
+			return 0;
+		}
+	}
+	long long tailleindex = 0;
+	FILE *fp;
+	if (fopen_s(&fp, nomindex.c_str(), "rb") == 0 && fp)
+	{
+		tailleindex = tailleFichier(fp);
+		fclose(fp);
+	}
+	if (taillejournal > EMPREINTES_JOURNAL_MIN && taillejournal > tailleindex / 16)
+	{
+		return fusionnerIndexEmpreintes(nomindex);
+	}
+	return 1;
+}
+
+// Valeurs de 16 bits  distance au plus rayon de valeur (chaque combinaison de bits inverss une seule fois)
+static void voisinsMorceau(unsigned valeur, int rayon, int depuis, vector<unsigned> &voisins)
+{
+	voisins.push_back(valeur);
+	for (int b = depuis; rayon > 0 && b < 16; b++)
+	{
+		voisinsMorceau(valeur ^ (1u << b), rayon - 1, b + 1, voisins);
+	}
+}
+
+// Cherche les entres dont l'empreinte est  distance au plus distmax, tries de la plus proche  la plus lointaine ; distances reoit leurs distances
+// Seules les cases voisines des morceaux de l'empreinte sont lues dans l'index, puis le journal qui n'a pas encore t fusionn
+int rechercherEmpreinte(string nomindex, unsigned long long empreinte, int distmax, vector<EntreeEmpreinte> &resultats, vector<int> *distances = NULL)
+{
+	resultats.clear();
+	vector<pair<int, EntreeEmpreinte> > trouves;
+	unsigned long long nb, taillemeta;
+	FILE *fp = ouvrirIndexEmpreintes(nomindex, nb, taillemeta);
+	if (fp)
+	{
+		// (distance, position des mtadonnes, empreinte, longueur des mtadonnes) ; une entre peut tre trouve par plusieurs tables
+		vector<pair<pair<int, unsigned long long>, pair<unsigned long long, unsigned> > > candidats;
+		vector<unsigned> voisins;
+		vector<unsigned char> brutes;
+		bool ok = true;
+		for (int t = 0; ok && t < EMPREINTES_NBTABLES; t++)
+		{
+			voisins.clear();
+			voisinsMorceau(morceauEmpreinte(empreinte, t), distmax / EMPREINTES_NBTABLES, 0, voisins);
+			for (size_t v = 0; ok && v < voisins.size(); v++)
+			{
+				unsigned char bornes[8];
+				ok = lireAPosition(fp, positionCasesEmpreintes(t) + (long long)voisins[v] * 4, bornes, 8);
+				unsigned long long debut = lireEntierLE(bornes, 4), fin = lireEntierLE(bornes + 4, 4);
+				if (!ok || fin <= debut)
+				{
+					continue;
+				}
+				ok = fin <= nb;
+				brutes.resize((size_t)(fin - debut) * EMPREINTES_TAILLE_ENTREE);
+				ok = ok && lireAPosition(fp, positionEntreesEmpreintes(nb, t) + (long long)debut * EMPREINTES_TAILLE_ENTREE, &brutes[0], brutes.size());
+				for (size_t k = 0; ok && k < fin - debut; k++)
+				{
+					const unsigned char *e = &brutes[k * EMPREINTES_TAILLE_ENTREE];
+					unsigned long long h = lireEntierLE(e, 8);
+					int d = distanceEmpreintes(h, empreinte);
+					if (d <= distmax)
+					{
+						candidats.push_back(make_pair(make_pair(d, lireEntierLE(e + 8, 8)), make_pair(h, (unsigned)lireEntierLE(e + 16, 4))));
+					}
+				}
+			}
+		}
+		sort(candidats.begin(), candidats.end());
+		candidats.erase(unique(candidats.begin(), candidats.end()), candidats.end());
+		for (size_t c = 0; ok && c < candidats.size(); c++)
+		{
+			unsigned long long position = candidats[c].first.second, longueur = candidats[c].second.second;
+			string meta((size_t)longueur, ' ');
+			EntreeEmpreinte entree;
+			if (position + longueur <= taillemeta && (longueur == 0 || lireAPosition(fp, positionEntreesEmpreintes(nb, EMPREINTES_NBTABLES) + (long long)position, &meta[0], (size_t)longueur))
+				&& lireLigneEmpreinte("0\t" + meta, entree))
+			{
+				entree.empreinte = candidats[c].second.first;
+				trouves.push_back(make_pair(candidats[c].first.first, entree));
+			}
+		}
+		fclose(fp);
+		if (!ok)
+		{
+			cout << "Index incorrect " << nomindex << endl;
+		}
+	}
+
+	// Journal (et journal en cours de fusion), parcouru en entier : il reste petit
+	vector<EntreeEmpreinte> journal;
+	lireJournalEmpreintes(nomindex + ".fusion", journal);
+	lireJournalEmpreintes(nomindex + ".journal", journal);
+	for (size_t n = 0; n < journal.size(); n++)
+	{
+		int d = distanceEmpreintes(journal[n].empreinte, empreinte);
+		if (d <= distmax)
+		{
+			trouves.push_back(make_pair(d, journal[n]));
+		}
+	}
+
+	stable_sort(trouves.begin(), trouves.end(), [](const pair<int, EntreeEmpreinte> &a, const pair<int, EntreeEmpreinte> &b) { return a.first < b.first; });
+	if (distances)
+	{
+		distances->clear();
+	}
+	for (size_t t = 0; t < trouves.size(); t++)
+	{
+		resultats.push_back(trouves[t].second);
+		if (distances)
+		{
+			distances->push_back(trouves[t].first);
+		}
+	}
+	return (int)resultats.size();
+}
+
+//  appeler juste aprs le marquage d'une image en niveau de gris : calcule son empreinte et l'enregistre dans l'index
+int indexerPGM(string nomindex, unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, string schema, string parametres, string fichier)
+{
+	EntreeEmpreinte entree = { empreintePGM(im_gris, rows, cols), schema, parametres, fichier };
+	return enregistrerEmpreinte(nomindex, entree);
+}
+
+//  appeler juste aprs le marquage d'une image couleur : calcule son empreinte et l'enregistre dans l'index
+int indexerPPM(string nomindex, PPMImage *image, string schema, string parametres, string fichier)
+{
+	EntreeEmpreinte entree = { empreintePPM(image), schema, parametres, fichier };
+	return enregistrerEmpreinte(nomindex, entree);
+}
+
+// Mme chose pour une image PNM 8 ou 16 bits : l'empreinte est calcule sur la luminance ramene  8 bits
+template <typename T> int indexerPNM(string nomindex, const ImagePNMT<T> &image, string schema, string parametres, string fichier)
+{
+	const EntetePNM &e = image.entete;
+	vector<unsigned char> lum((size_t)e.largeur * e.hauteur);
+	for (size_t p = 0; p < lum.size(); p++)
+	{
+		const T *pixel = &image.donnees[p * e.canaux];
+		long v = e.canaux >= 3 ? (77L * pixel[0] + 150L * pixel[1] + 29L * pixel[2]) >> 8 : pixel[0];
+		lum[p] = (unsigned char)(v * 255 / (e.maxval > 0 ? e.maxval : 1));
+	}
+	EntreeEmpreinte entree = { empreinteLuminance(&lum[0], e.hauteur, e.largeur, e.largeur), schema, parametres, fichier };
+	return enregistrerEmpreinte(nomindex, entree);
+}
+
+// Variation d'une unit 8 bits ramene  la profondeur de l'image (1 pour maxval 255, 257 pour maxval 65535)
+template <typename T> int uniteEchantillonPNM(const ImagePNMT<T> &image)
+{
+	int unite = (image.entete.maxval + 1) / 256;
+	return unite < 1 ? 1 : unite;
+}
+
+// Cache des octets dans les bits de poids faible des chantillons conscutifs d'une image PNM 8 ou 16 bits,  partir de l'chantillon debut
+// Disposition est un Decoupage ; en 16 bits un dcoupage plus large (Decoupage<4, 4> par exemple) reste invisible. Renvoie 1 si tout a t cach
+template <typename Disposition, typename T> int dissimulationOctetsPNM(ImagePNMT<T> &image, size_t debut, const string &octets)
+{
+	if (debut + octets.size() * Disposition::nbcomposantes > image.donnees.size())
+	{
+		cout << "Chaine de caractere trop longue par rapport a l image" << endl;
+		return 0;
+	}
+	T *p = image.donnees.empty() ? NULL : &image.donnees[debut];
+	for (size_t c = 0; c < octets.size(); c++, p += Disposition::nbcomposantes)
+	{
+		Disposition::cacher((unsigned char)octets[c], p);
+	}
+	return 1;
+}
+
+// Extrait nboctets octets cachs par dissimulationOctetsPNM avec la mme disposition
+template <typename Disposition, typename T> int extractionOctetsPNM(const ImagePNMT<T> &image, size_t debut, size_t nboctets, string &octets)
+{
+	if (debut + nboctets * Disposition::nbcomposantes > image.donnees.size())
+	{
+		cout << "En dehors de l'image" << endl;
+		return 0;
+	}
+	octets.resize(nboctets);
+	const T *p = image.donnees.empty() ? NULL : &image.donnees[debut];
+	for (size_t c = 0; c < nboctets; c++, p += Disposition::nbcomposantes)
+	{
+		octets[c] = (char)Disposition::extraire(p);
+	}
+	return 1;
+}
+
+// Mthode du patchwork sur une image PNM 8 ou 16 bits : toutes les composantes du premier carr baissent de force, celles du second montent de force
+// debutcarre1 et debutcarre2 sont des indices de pixel (ligne * largeur + colonne) ; force <= 0 prend une unit  la profondeur de l'image
+template <typename T> void patchworkPNM(ImagePNMT<T> &image, long debutcarre1, long debutcarre2, int taillecarres, int force, const IndexationMarquage *indexation = NULL)
+{
+	const EntetePNM &e = image.entete;
+	if (force <= 0)
+	{
+		force = uniteEchantillonPNM(image);
+	}
+	long debuts[2] = { debutcarre1, debutcarre2 };
+	int signes[2] = { -force, force };
+	for (int c = 0; c < 2; c++)
+	{
+		long i0 = debuts[c] / e.largeur, j0 = debuts[c] % e.largeur;
+		for (long i = i0; i < i0 + taillecarres && i < e.hauteur; i++)
+		{
+			T *ligne = &image.donnees[(i * e.largeur + j0) * e.canaux];
+			long nb = (j0 + taillecarres > e.largeur ? e.largeur - j0 : taillecarres) * e.canaux;
+			for (long n = 0; n < nb; n++)
+			{
+				int v = ligne[n] + signes[c];
+				ligne[n] = (T)(v < 0 ? 0 : (v > e.maxval ? e.maxval : v));
+			}
+		}
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "debut1=%ld debut2=%ld taille=%d force=%d", debutcarre1, debutcarre2, taillecarres, force);
+		indexerPNM(indexation->nomindex, image, "patchwork", parametres, indexation->fichier);
+	}
+}
+
+// Mesure du patchwork : cart moyen entre le second et le premier carr, en units 8 bits (proche de 2 pour une image marque avec force 1)
+template <typename T> double detectionPatchworkPNM(const ImagePNMT<T> &image, long debutcarre1, long debutcarre2, int taillecarres)
+{
+	const EntetePNM &e = image.entete;
+	double sommes[2] = { 0, 0 };
+	long nbs[2] = { 0, 0 };
+	long debuts[2] = { debutcarre1, debutcarre2 };
+	for (int c = 0; c < 2; c++)
+	{
+		long i0 = debuts[c] / e.largeur, j0 = debuts[c] % e.largeur;
+		for (long i = i0; i < i0 + taillecarres && i < e.hauteur; i++)
+		{
+			const T *ligne = &image.donnees[(i * e.largeur + j0) * e.canaux];
+			long nb = (j0 + taillecarres > e.largeur ? e.largeur - j0 : taillecarres) * e.canaux;
+			for (long n = 0; n < nb; n++)
+			{
+				sommes[c] += ligne[n];
+			}
+			nbs[c] += nb;
+		}
+	}
+	if (nbs[0] == 0 || nbs[1] == 0)
+	{
+		return 0;
+	}
+	return (sommes[1] / nbs[1] - sommes[0] / nbs[0]) / uniteEchantillonPNM(image);
+}
+
+// Dissimule une chaine de 8 caractres dans le bloc 8 * 8 commenant en (x, y) d'une composante d'une image PNM 8 ou 16 bits (comme l'exercice 3)
+// a est exprim en units 8 bits et multipli par la profondeur de l'image, ce qui laisse plus de marge en 16 bits
+template <typename T> int dissimulationChaineCaracPNM(ImagePNMT<T> &image, int canal, int a, long x, long y, string texteacacher, const IndexationMarquage *indexation = NULL)
+{
+	const EntetePNM &e = image.entete;
+	if (x < 0 || y < 0 || x + 8 > e.hauteur || y + 8 > e.largeur || canal < 0 || canal >= e.canaux)
+	{
+		cout << "En dehors de l'image" << endl;
+		return 0;
+	}
+	if (a == 0)
+	{
+		cout << "Constante ne doit pas etre nulle" << endl;
+		return 0;
+	}
+	texteacacher.resize(8);
+	int force = a * uniteEchantillonPNM(image);
+	for (long i = x; i < x + 8; i++)
+	{
+		for (long j = y; j < y + 8; j++)
+		{
+			T &v = image.donnees[(i * e.largeur + j) * e.canaux + canal];
+			int tmp = v + force * wByte((int)((i - x) * 8 + (j - y)), texteacacher);
+			v = (T)(tmp < 0 ? 0 : (tmp > e.maxval ? e.maxval : tmp));
+		}
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "canal=%d a=%d x=%ld y=%ld", canal, a, x, y);
+		indexerPNM(indexation->nomindex, image, "chaine8", parametres, indexation->fichier);
+	}
+	return 1;
+}
+
+// Extrait la chaine cache par dissimulationChaineCaracPNM : le signe de la diffrence avec l'originale donne chaque bit
+template <typename T> int extractionChaineCaracPNM(const ImagePNMT<T> &orig, const ImagePNMT<T> &modif, int canal, long x, long y, string &textearecup)
+{
+	const EntetePNM &e = orig.entete;
+	if (modif.entete.largeur != e.largeur || modif.entete.hauteur != e.hauteur || modif.entete.canaux != e.canaux)
+	{
+		cout << "Erreur, les deux images ne sont pas de la meme taille." << endl;
+		return 0;
+	}
+	if (x < 0 || y < 0 || x + 8 > e.hauteur || y + 8 > e.largeur || canal < 0 || canal >= e.canaux)
+	{
+		cout << "En dehors de l'image" << endl;
+		return 0;
+	}
+	textearecup.resize(8);
+	for (long i = x; i < x + 8; i++)
+	{
+		unsigned char tmptot = 0;
+		for (long j = y; j < y + 8; j++)
+		{
+			size_t n = (i * e.largeur + j) * e.canaux + canal;
+			tmptot = (unsigned char)((tmptot << 1) | (modif.donnees[n] >= orig.donnees[n]));
+		}
+		textearecup[i - x] = (char)tmptot;
+	}
+	return 1;
+}
+
+// Lit l'en-tte d'une image PNM depuis le dbut d'un fichier ouvert, par blocs de 4 Ko jusqu' ce qu'il soit complet
+int lireEntetePNMFichier(FILE *fp, EntetePNM &entete)
+{
+	vector<unsigned char> tampon;
+	size_t lus = 0;
+	int r = PNM_INCOMPLET;
+	bool fin = false;
+	while (r == PNM_INCOMPLET && !fin)
+	{
+		tampon.resize(lus + 4096);
+		size_t n = fread(&tampon[lus], 1, 4096, fp);
+		lus += n;
+		fin = (n < 4096);
+		r = analyserEntetePNM(&tampon[0], lus, fin, entete);
+	}
+	return r == PNM_INCOMPLET ? PNM_ERREUR_ENTETE : r;
+}
+
+// Lit seulement l'en-tte d'une image PNM, sans toucher aux pixels
+int lireEntetePNM(const char *filename, EntetePNM &entete)
+{
+	FILE *fp;
+	if (fopen_s(&fp, filename, "rb") != 0 || !fp)
+	{
+		return PNM_ERREUR_OUVERTURE;
+	}
+	int r = lireEntetePNMFichier(fp, entete);
+	fclose(fp);
+	return r;
+}
+
+// Vrai si le nom de fichier a une extension PNM (.pbm, .pgm, .ppm, .pnm, .pam)
+bool estFichierPNM(const string &nom)
+{
+	size_t point = nom.rfind('.');
+	if (point == string::npos || nom.size() - point != 4)
+	{
+		return false;
+	}
+	string ext = nom.substr(point + 1);
+	for (size_t c = 0; c < ext.size(); c++)
+	{
+		ext[c] = (char)tolower((unsigned char)ext[c]);
+	}
+	return ext == "pbm" || ext == "pgm" || ext == "ppm" || ext == "pnm" || ext == "pam";
+}
+
+// Ajoute  fichiers toutes les images PNM du dossier et de ses sous-dossiers
+void listerFichiersPNM(string dossier, vector<string> &fichiers)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA trouve;
+	HANDLE h = FindFirstFileA((dossier + "\\*").c_str(), &trouve);
+	if (h == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	do
+	{
+		string nom = trouve.cFileName;
+		if (nom == "." || nom == "..")
+		{
+			continue;
+		}
+		if (trouve.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			listerFichiersPNM(dossier + "\\" + nom, fichiers);
+		}
+		else if (estFichierPNM(nom))
+		{
+			fichiers.push_back(dossier + "\\" + nom);
+		}
+	} while (FindNextFileA(h, &trouve));
+	FindClose(h);
+#else
+	DIR *d = opendir(dossier.c_str());
+	if (!d)
+	{
+		return;
+	}
+	struct dirent *entree;
+	while ((entree = readdir(d)) != NULL)
+	{
+		string nom = entree->d_name;
+		if (nom == "." || nom == "..")
+		{
+			continue;
+		}
+		string chemin = dossier + "/" + nom;
+		struct stat infos;
+		if (stat(chemin.c_str(), &infos) != 0)
+		{
+			continue;
+		}
+		if (S_ISDIR(infos.st_mode))
+		{
+			listerFichiersPNM(chemin, fichiers);
+		}
+		else if (estFichierPNM(nom))
+		{
+			fichiers.push_back(chemin);
+		}
+	}
+	closedir(d);
+#endif
+}
+
+// Capacits d'une image pour chaque mthode, calcules  partir de son seul en-tte
+typedef struct {
+	string fichier;
+	int code;                // code de retour de lireEntetePNM
+	EntetePNM entete;
+	long long texte;         // caractres pour dissimulationTexteDansPGM (0 si l'image n'est pas en niveau de gris ou dpasse MAXROWS * MAXCOLS)
+	long long blocs;         // blocs 8 * 8 entiers, chacun pouvant porter une chaine de 8 caractres (exercice 3) ou une marque DCT
+	long long pgmdansppm;    // pixels de l'image grise de mme taille accepte par dissimulationPGMdansPPM (0 si l'image n'est pas en couleur)
+	long long octetslsb;     // octets pour dissimulationOctetsPNM avec DecoupageTexte (4 chantillons par octet)
+	bool patchwork;          // assez grande pour les carrs de 30 * 30 de patchworkPGM / patchworkPPM
+} CapaciteImage;
+
+// Calcule les capacits d'une image d'aprs son en-tte
+void capaciteImage(CapaciteImage &capacite)
+{
+	const EntetePNM &e = capacite.entete;
+	capacite.texte = capacite.blocs = capacite.pgmdansppm = capacite.octetslsb = 0;
+	capacite.patchwork = false;
+	if (capacite.code != PNM_OK)
+	{
+		return;
+	}
+	bool tableau = e.hauteur <= MAXROWS && e.largeur <= MAXCOLS;
+	if (e.canaux == 1 && tableau)
+	{
+		// Limite annonce par dissimulationTexteDansPGM, et celle du carr de ct 4 * sqrt(n) qui doit tenir dans l'image (avec k = 0),
+		// rduite tant que le dbordement  droite du dernier caractre de chaque ligne sort de l'image
+		long long limite = (long long)e.largeur * e.hauteur / 4;
+		long cote = min(e.hauteur, e.largeur) / 4;
+		long long carre = (long long)cote * cote;
+		capacite.texte = limite < carre ? limite : carre;
+		while (capacite.texte > 0 && !carreTexteTient(e.hauteur, e.largeur, 0, (size_t)capacite.texte))
+		{
+			capacite.texte--;
+		}
+	}
+	capacite.blocs = (long long)(e.hauteur / 8) * (e.largeur / 8);
+	if (e.canaux == 3 && tableau)
+	{
+		capacite.pgmdansppm = (long long)e.largeur * e.hauteur;
+	}
+	capacite.octetslsb = (long long)e.largeur * e.hauteur * e.canaux / DecoupageTexte::nbcomposantes;
+	capacite.patchwork = e.largeur >= 30 && e.hauteur >= 30;
+}
+
+// Parcourt un dossier et ses sous-dossiers, lit en parallle l'en-tte de chaque image PNM et crit un manifeste (une ligne par image, champs spars par des tabulations)
+// Renvoie le nombre d'images dont l'en-tte est correct
+int scannerCorpus(string dossier, string manifeste, int nbthreads)
+{
+	vector<string> fichiers;
+	listerFichiersPNM(dossier, fichiers);
+	sort(fichiers.begin(), fichiers.end());
+	if (nbthreads <= 0)
+	{
+		nbthreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	}
+
+	vector<CapaciteImage> capacites(fichiers.size());
+	atomic<size_t> prochain(0);
+	auto travail = [&]()
+	{
+		size_t n;
+		while ((n = prochain.fetch_add(1)) < fichiers.size())
+		{
+			capacites[n].fichier = fichiers[n];
+			capacites[n].code = lireEntetePNM(fichiers[n].c_str(), capacites[n].entete);
+			capaciteImage(capacites[n]);
+		}
+	};
+	vector<thread> threads;
+	for (int t = 1; t < nbthreads; t++)
+	{
+		threads.push_back(thread(travail));
+	}
+	travail();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+
+	ofstream f(manifeste.c_str());
+	if (f.fail())
+	{
+		cout << "Impossible d'ecrire le manifeste " << manifeste << endl;
+		return 0;
+	}
+	f << "# fichier\tformat\tlargeur\thauteur\tcanaux\tmaxval\ttexte\tblocs8x8\tpgmdansppm\toctetslsb\tpatchwork\terreur\n";
+	int correctes = 0;
+	for (size_t n = 0; n < capacites.size(); n++)
+	{
+		const CapaciteImage &c = capacites[n];
+		f << c.fichier << '\t';
+		if (c.code == PNM_OK)
+		{
+			f << 'P' << c.entete.format << '\t' << c.entete.largeur << '\t' << c.entete.hauteur << '\t' << c.entete.canaux << '\t' << c.entete.maxval << '\t'
+				<< c.texte << '\t' << c.blocs << '\t' << c.pgmdansppm << '\t' << c.octetslsb << '\t' << (c.patchwork ? 1 : 0) << "\t-\n";
+			correctes++;
+		}
+		else
+		{
+			f << "-\t0\t0\t0\t0\t0\t0\t0\t0\t0\t" << messageErreurPNM(c.code) << '\n';
+		}
+	}
+	return correctes;
+}
+
+// Lit une zone rectangulaire d'une image PNM binaire (P5, P6, P7) sans charger le reste du fichier :
+// la position de chaque ligne de la zone se dduit de l'en-tte, puis une seule lecture positionne par ligne (une en tout si la zone fait toute la largeur)
+// La zone est rendue comme une petite image de nbcols * nblignes ; l'en-tte complet du fichier est recopi dans entetefichier s'il est donn
+template <typename T> int lireZonePNM(const char *filename, long ligne0, long nblignes, long col0, long nbcols, ImagePNMT<T> &zone, EntetePNM *entetefichier = NULL)
+{
+	FILE *fp;
+	if (fopen_s(&fp, filename, "rb") != 0 || !fp)
+	{
+		return PNM_ERREUR_OUVERTURE;
+	}
+	EntetePNM e;
+	int r = lireEntetePNMFichier(fp, e);
+	if (r == PNM_OK && e.format != 5 && e.format != 6 && e.format != 7)
+	{
+		// Les formats ASCII et PBM binaire n'ont pas de position fixe par pixel
+		r = PNM_ERREUR_FORMAT;
+	}
+	if (r == PNM_OK && e.maxval > (int)numeric_limits<T>::max())
+	{
+		r = PNM_ERREUR_PROFONDEUR;
+	}
+	if (r == PNM_OK && (ligne0 < 0 || col0 < 0 || nblignes < 1 || nbcols < 1 || ligne0 + nblignes > e.hauteur || col0 + nbcols > e.largeur))
+	{
+		r = PNM_ERREUR_DONNEES;
+	}
+	if (r != PNM_OK)
+	{
+		fclose(fp);
+		return r;
+	}
+	if (entetefichier)
+	{
+		*entetefichier = e;
+	}
+
+	int octets = e.maxval > 255 ? 2 : 1;
+	long long pas = (long long)e.largeur * e.canaux * octets;
+	size_t parligne = (size_t)nbcols * e.canaux * octets;
+	bool entiere = (col0 == 0 && nbcols == e.largeur);
+	vector<unsigned char> tampon(entiere ? parligne * nblignes : parligne);
+
+	zone.entete = e;
+	zone.entete.largeur = nbcols;
+	zone.entete.hauteur = nblignes;
+	zone.entete.debutdonnees = 0;
+	zone.donnees.resize((size_t)nbcols * nblignes * e.canaux);
+
+	if (entiere)
+	{
+		if (!lireAPosition(fp, e.debutdonnees + ligne0 * pas, &tampon[0], tampon.size()))
+		{
+			r = PNM_ERREUR_DONNEES;
+		}
+		else
+		{
+			copierEchantillonsPNM(&tampon[0], zone.donnees.size(), octets, &zone.donnees[0]);
+		}
+	}
+	else
+	{
+		for (long i = 0; i < nblignes && r == PNM_OK; i++)
+		{
+			long long position = e.debutdonnees + (ligne0 + i) * pas + (long long)col0 * e.canaux * octets;
+			if (!lireAPosition(fp, position, &tampon[0], parligne))
+			{
+				r = PNM_ERREUR_DONNEES;
+			}
+			else
+			{
+				copierEchantillonsPNM(&tampon[0], (size_t)nbcols * e.canaux, octets, &zone.donnees[(size_t)i * nbcols * e.canaux]);
+			}
+		}
+	}
+	fclose(fp);
+	return r;
+}
+
+// Extrait la chaine de l'exercice 3 en ne lisant que le bloc 8 * 8 en (x, y) de l'image originale et de l'image marque
+// Marche pour les images 8 et 16 bits. Renvoie PNM_OK ou un code d'erreur
+int extractionChaineCaracPartielle(const char *fichierorig, const char *fichiermodif, int canal, long x, long y, string &textearecup)
+{
+	ImagePNM16 orig, modif;
+	int r = lireZonePNM(fichierorig, x, 8, y, 8, orig);
+	if (r == PNM_OK)
+	{
+		r = lireZonePNM(fichiermodif, x, 8, y, 8, modif);
+	}
+	if (r != PNM_OK)
+	{
+		cout << "Erreur de lecture partielle : " << messageErreurPNM(r) << endl;
+		return r;
+	}
+	return extractionChaineCaracPNM(orig, modif, canal, 0, 0, textearecup) ? PNM_OK : PNM_ERREUR_DONNEES;
+}
+
+// Moyennes des deux carrs d'une image dont l'en-tte e est dj lu, par lectures partielles
+static int mesurePatchworkPartielle(const char *filename, const EntetePNM &e, long debutcarre1, long debutcarre2, int taillecarres, double &ecart)
+{
+	int r;
+	long debuts[2] = { debutcarre1, debutcarre2 };
+	double moyennes[2];
+	for (int c = 0; c < 2; c++)
+	{
+		long i0 = debuts[c] / e.largeur, j0 = debuts[c] % e.largeur;
+		long nblignes = i0 + taillecarres > e.hauteur ? e.hauteur - i0 : taillecarres;
+		long nbcols = j0 + taillecarres > e.largeur ? e.largeur - j0 : taillecarres;
+		ImagePNM16 carre;
+		if ((r = lireZonePNM(filename, i0, nblignes, j0, nbcols, carre)) != PNM_OK)
+		{
+			return r;
+		}
+		double somme = 0;
+		for (size_t n = 0; n < carre.donnees.size(); n++)
+		{
+			somme += carre.donnees[n];
+		}
+		moyennes[c] = somme / carre.donnees.size();
+	}
+	ecart = (moyennes[1] - moyennes[0]) / ((e.maxval + 1) / 256 < 1 ? 1 : (e.maxval + 1) / 256);
+	return PNM_OK;
+}
+
+// Mesure du patchwork (mme convention que patchworkPNM) en ne lisant que les lignes des deux carrs
+// ecart reoit l'cart moyen entre le second et le premier carr, en units 8 bits. Renvoie PNM_OK ou un code d'erreur
+int detectionPatchworkPartielle(const char *filename, long debutcarre1, long debutcarre2, int taillecarres, double &ecart)
+{
+	EntetePNM e;
+	int r = lireEntetePNM(filename, e);
+	if (r != PNM_OK)
+	{
+		return r;
+	}
+	return mesurePatchworkPartielle(filename, e, debutcarre1, debutcarre2, taillecarres, ecart);
+}
+
+// Mme mesure  partir de la seule cl : les deux carrs sont tirs comme dans patchworkPGM / patchworkPPM (Philox, mmes indices)
+// d'aprs la taille lue dans l'en-tte, puis seules leurs lignes sont lues
+int detectionPatchworkPartielle(const char *filename, unsigned long long cle, double &ecart)
+{
+	EntetePNM e;
+	int r = lireEntetePNM(filename, e);
+	if (r != PNM_OK)
+	{
+		return r;
+	}
+	if (e.largeur < PATCHWORK_TAILLE_CARRES || e.hauteur < PATCHWORK_TAILLE_CARRES)
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+	long debutcarre1 = debutCarreAleatoire(cle, 0, e.hauteur, e.largeur, PATCHWORK_TAILLE_CARRES);
+	long debutcarre2 = debutCarreAleatoire(cle, 1, e.hauteur, e.largeur, PATCHWORK_TAILLE_CARRES);
+	return mesurePatchworkPartielle(filename, e, debutcarre1, debutcarre2, PATCHWORK_TAILLE_CARRES, ecart);
+}
+
+// CRC-32 (polynme 0xEDB88320, comme zip et PNG) d'un bloc d'octets ; crc permet de continuer un calcul commenc sur un bloc prcdent
+unsigned crc32Octets(const unsigned char *octets, size_t taille, unsigned crc = 0)
+{
+	static unsigned table[256];
+	static const bool initialise = []()
+	{
+		for (unsigned n = 0; n < 256; n++)
+		{
+			unsigned c = n;
+			for (int k = 0; k < 8; k++)
+			{
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		return true;
+	}();
+	(void)initialise;
+	crc = ~crc;
+	for (size_t n = 0; n < taille; n++)
+	{
+		crc = table[(crc ^ octets[n]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+// crit taille octets  partir de position dans un fichier ouvert (pwrite sous Linux) ; sous Windows chaque thread doit avoir son propre FILE
+bool ecrireAPosition(FILE *fp, long long position, const void *src, size_t taille)
+{
+#ifdef _WIN32
+	if (_fseeki64(fp, position, SEEK_SET) != 0)
+	{
+		return false;
+	}
+	return fwrite(src, 1, taille, fp) == taille && fflush(fp) == 0;
+#else
+	size_t ecrits = 0;
+	while (ecrits < taille)
+	{
+		ssize_t n = pwrite(fileno(fp), (const char *)src + ecrits, taille - ecrits, (off_t)(position + ecrits));
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		ecrits += n;
+	}
+	return true;
+#endif
+}
+
+// Format tuil pour les trs grandes images : en-tte de 36 octets ("TATU", version, largeur, hauteur, canaux, maxval, ct des tuiles, tuiles en x et en y),
+// puis une entre d'index de 16 octets par tuile (position, taille, CRC-32), puis les tuiles, toutes de la mme taille
+// Une tuile contient ct * ct pixels, composantes entrelaces comme PPMPixel ou un pixel gris, sur 1 octet ou 2 octets petit-boutistes si maxval dpasse 255
+// Les tuiles du bord sont compltes par des zros
+#define TUILES_TAILLE_ENTETE 36
+#define TUILES_TAILLE_INDEX 16
+#define TUILES_VERSION 1
+
+typedef struct {
+	long largeur, hauteur;
+	int canaux, maxval, cote;
+	long nbtuilesx, nbtuilesy;
+	vector<unsigned long long> positions;
+	vector<unsigned> tailles, sommes;
+} EnteteTuiles;
+
+// Octets par chantillon et par tuile
+inline int octetsEchantillonTuiles(const EnteteTuiles &e)
+{
+	return e.maxval > 255 ? 2 : 1;
+}
+
+inline size_t tailleTuile(const EnteteTuiles &e)
+{
+	return (size_t)e.cote * e.cote * e.canaux * octetsEchantillonTuiles(e);
+}
+
+// Prpare l'en-tte et l'index d'un fichier tuil : les tuiles sont ranges ligne par ligne juste aprs l'index
+void initialiserEnteteTuiles(EnteteTuiles &e, long largeur, long hauteur, int canaux, int maxval, int cote)
+{
+	e.largeur = largeur;
+	e.hauteur = hauteur;
+	e.canaux = canaux;
+	e.maxval = maxval;
+	e.cote = cote;
+	e.nbtuilesx = (largeur + cote - 1) / cote;
+	e.nbtuilesy = (hauteur + cote - 1) / cote;
+	size_t nb = (size_t)e.nbtuilesx * e.nbtuilesy;
+	e.positions.resize(nb);
+	e.tailles.assign(nb, (unsigned)tailleTuile(e));
+	e.sommes.assign(nb, 0);
+	for (size_t t = 0; t < nb; t++)
+	{
+		e.positions[t] = TUILES_TAILLE_ENTETE + nb * TUILES_TAILLE_INDEX + t * tailleTuile(e);
+	}
+}
+
+// crit l'en-tte et tout l'index au dbut du fichier
+bool ecrireEnteteTuiles(FILE *fp, const EnteteTuiles &e)
+{
+	size_t nb = e.positions.size();
+	vector<unsigned char> tampon(TUILES_TAILLE_ENTETE + nb * TUILES_TAILLE_INDEX);
+	memcpy(&tampon[0], "TATU", 4);
+	ecrireEntierLE(&tampon[4], TUILES_VERSION, 4);
+	ecrireEntierLE(&tampon[8], e.largeur, 4);
+	ecrireEntierLE(&tampon[12], e.hauteur, 4);
+	ecrireEntierLE(&tampon[16], e.canaux, 4);
+	ecrireEntierLE(&tampon[20], e.maxval, 4);
+	ecrireEntierLE(&tampon[24], e.cote, 4);
+	ecrireEntierLE(&tampon[28], e.nbtuilesx, 4);
+	ecrireEntierLE(&tampon[32], e.nbtuilesy, 4);
+	for (size_t t = 0; t < nb; t++)
+	{
+		unsigned char *entree = &tampon[TUILES_TAILLE_ENTETE + t * TUILES_TAILLE_INDEX];
+		ecrireEntierLE(entree, e.positions[t], 8);
+		ecrireEntierLE(entree + 8, e.tailles[t], 4);
+		ecrireEntierLE(entree + 12, e.sommes[t], 4);
+	}
+	return ecrireAPosition(fp, 0, &tampon[0], tampon.size());
+}
+
+// Lit l'en-tte et l'index d'un fichier tuil. Renvoie PNM_OK ou un code d'erreur PNM
+int lireEnteteTuiles(FILE *fp, EnteteTuiles &e)
+{
+	unsigned char entete[TUILES_TAILLE_ENTETE];
+	if (!lireAPosition(fp, 0, entete, TUILES_TAILLE_ENTETE))
+	{
+		return PNM_ERREUR_ENTETE;
+	}
+	if (memcmp(entete, "TATU", 4) != 0 || lireEntierLE(entete + 4, 4) != TUILES_VERSION)
+	{
+		return PNM_ERREUR_FORMAT;
+	}
+	e.largeur = (long)lireEntierLE(entete + 8, 4);
+	e.hauteur = (long)lireEntierLE(entete + 12, 4);
+	e.canaux = (int)lireEntierLE(entete + 16, 4);
+	e.maxval = (int)lireEntierLE(entete + 20, 4);
+	e.cote = (int)lireEntierLE(entete + 24, 4);
+	e.nbtuilesx = (long)lireEntierLE(entete + 28, 4);
+	e.nbtuilesy = (long)lireEntierLE(entete + 32, 4);
+	if (e.largeur < 1 || e.hauteur < 1 || e.canaux < 1 || e.maxval < 1 || e.maxval > 65535 || e.cote < 1
+		|| e.nbtuilesx != (e.largeur + e.cote - 1) / e.cote || e.nbtuilesy != (e.hauteur + e.cote - 1) / e.cote)
+	{
+		return PNM_ERREUR_ENTETE;
+	}
+	// Le nombre de tuiles, leur taille et leurs positions viennent du fichier : elles sont vrifies contre sa taille avant toute allocation
+	long long taille = tailleFichier(fp);
+	if (taille < TUILES_TAILLE_ENTETE
+		|| (unsigned long long)e.cote * e.cote > (unsigned long long)taille / ((unsigned long long)e.canaux * octetsEchantillonTuiles(e))
+		|| (unsigned long long)e.nbtuilesx * e.nbtuilesy > (unsigned long long)(taille - TUILES_TAILLE_ENTETE) / TUILES_TAILLE_INDEX)
+	{
+		return PNM_ERREUR_ENTETE;
+	}
+	size_t nb = (size_t)e.nbtuilesx * e.nbtuilesy;
+	unsigned long long debutdonnees = TUILES_TAILLE_ENTETE + (unsigned long long)nb * TUILES_TAILLE_INDEX;
+	vector<unsigned char> index(nb * TUILES_TAILLE_INDEX);
+	if (!lireAPosition(fp, TUILES_TAILLE_ENTETE, &index[0], index.size()))
+	{
+		return PNM_ERREUR_ENTETE;
+	}
+	e.positions.resize(nb);
+	e.tailles.resize(nb);
+	e.sommes.resize(nb);
+	for (size_t t = 0; t < nb; t++)
+	{
+		e.positions[t] = lireEntierLE(&index[t * TUILES_TAILLE_INDEX], 8);
+		e.tailles[t] = (unsigned)lireEntierLE(&index[t * TUILES_TAILLE_INDEX + 8], 4);
+		e.sommes[t] = (unsigned)lireEntierLE(&index[t * TUILES_TAILLE_INDEX + 12], 4);
+		if (e.tailles[t] != tailleTuile(e) || e.positions[t] < debutdonnees || e.positions[t] > (unsigned long long)taille - e.tailles[t])
+		{
+			return PNM_ERREUR_ENTETE;
+		}
+	}
+	return PNM_OK;
+}
+
+// Lit la tuile (tx, ty) et la rend comme une image PNM de ct * ct pixels ; la somme CRC-32 est vrifie
+template <typename T> int lireTuile(FILE *fp, const EnteteTuiles &e, long tx, long ty, ImagePNMT<T> &tuile)
+{
+	if (tx < 0 || ty < 0 || tx >= e.nbtuilesx || ty >= e.nbtuilesy)
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+	if (e.maxval > (int)numeric_limits<T>::max())
+	{
+		return PNM_ERREUR_PROFONDEUR;
+	}
+	size_t t = (size_t)ty * e.nbtuilesx + tx;
+	vector<unsigned char> octets(e.tailles[t]);
+	if (!lireAPosition(fp, e.positions[t], &octets[0], octets.size()) || crc32Octets(&octets[0], octets.size()) != e.sommes[t])
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+	tuile.entete.format = e.canaux == 1 ? 5 : (e.canaux == 3 ? 6 : 7);
+	tuile.entete.largeur = e.cote;
+	tuile.entete.hauteur = e.cote;
+	tuile.entete.canaux = e.canaux;
+	tuile.entete.maxval = e.maxval;
+	tuile.entete.typetuple.clear();
+	tuile.entete.debutdonnees = 0;
+	tuile.donnees.resize((size_t)e.cote * e.cote * e.canaux);
+	int largeur = octetsEchantillonTuiles(e);
+	for (size_t n = 0; n < tuile.donnees.size(); n++)
+	{
+		tuile.donnees[n] = (T)lireEntierLE(&octets[n * largeur], largeur);
+	}
+	return PNM_OK;
+}
+
+// Rcrit la tuile (tx, ty)  sa place puis met  jour sa somme dans l'index, sans toucher au reste du fichier
+// Des threads diffrents peuvent crire des tuiles diffrentes en mme temps, chacun avec son propre FILE
+template <typename T> int ecrireTuile(FILE *fp, EnteteTuiles &e, long tx, long ty, const ImagePNMT<T> &tuile)
+{
+	if (tx < 0 || ty < 0 || tx >= e.nbtuilesx || ty >= e.nbtuilesy || tuile.donnees.size() != (size_t)e.cote * e.cote * e.canaux)
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+	size_t t = (size_t)ty * e.nbtuilesx + tx;
+	int largeur = octetsEchantillonTuiles(e);
+	vector<unsigned char> octets(e.tailles[t]);
+	for (size_t n = 0; n < tuile.donnees.size(); n++)
+	{
+		ecrireEntierLE(&octets[n * largeur], tuile.donnees[n], largeur);
+	}
+	e.sommes[t] = crc32Octets(&octets[0], octets.size());
+	unsigned char entree[TUILES_TAILLE_INDEX];
+	ecrireEntierLE(entree, e.positions[t], 8);
+	ecrireEntierLE(entree + 8, e.tailles[t], 4);
+	ecrireEntierLE(entree + 12, e.sommes[t], 4);
+	if (!ecrireAPosition(fp, e.positions[t], &octets[0], octets.size())
+		|| !ecrireAPosition(fp, TUILES_TAILLE_ENTETE + t * TUILES_TAILLE_INDEX, entree, TUILES_TAILLE_INDEX))
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+	return PNM_OK;
+}
+
+// Copie une bande de lignes d'image (toute la largeur) dans une range de tuiles, ou l'inverse
+template <typename T> void copierBandeTuile(ImagePNMT<T> &bande, ImagePNMT<T> &tuile, long tx, int cote, bool verstuile)
+{
+	int canaux = bande.entete.canaux;
+	long j0 = tx * cote;
+	long nbcols = j0 + cote > bande.entete.largeur ? bande.entete.largeur - j0 : cote;
+	for (long i = 0; i < bande.entete.hauteur; i++)
+	{
+		T *b = &bande.donnees[(i * bande.entete.largeur + j0) * canaux];
+		T *t = &tuile.donnees[(size_t)i * cote * canaux];
+		if (verstuile)
+		{
+			copy(b, b + nbcols * canaux, t);
+		}
+		else
+		{
+			copy(t, t + nbcols * canaux, b);
+		}
+	}
+}
+
+// Convertit une image PNM binaire (P5, P6, P7) en fichier tuil, une range de tuiles  la fois pour ne jamais charger toute l'image
+int convertirPNMversTuiles(const char *fichierpnm, const char *fichiertuiles, int cote)
+{
+	EntetePNM ep;
+	int r = lireEntetePNM(fichierpnm, ep);
+	if (r != PNM_OK)
+	{
+		return r;
+	}
+	if (cote < 1)
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+	EnteteTuiles e;
+	initialiserEnteteTuiles(e, ep.largeur, ep.hauteur, ep.canaux, ep.maxval, cote);
+
+	char temporaire[1024];
+	nomTemporaire(temporaire, sizeof(temporaire), fichiertuiles);
+	FILE *fp;
+	if (fopen_s(&fp, temporaire, "w+b") != 0 || !fp)
+	{
+		return PNM_ERREUR_OUVERTURE;
+	}
+	ImagePNM16 bande, tuile;
+	tuile.donnees.resize((size_t)cote * cote * e.canaux);
+	for (long ty = 0; ty < e.nbtuilesy && r == PNM_OK; ty++)
+	{
+		long nblignes = (ty + 1) * cote > e.hauteur ? e.hauteur - ty * cote : cote;
+		r = lireZonePNM(fichierpnm, ty * cote, nblignes, 0, e.largeur, bande);
+		for (long tx = 0; tx < e.nbtuilesx && r == PNM_OK; tx++)
+		{
+			fill(tuile.donnees.begin(), tuile.donnees.end(), 0);
+			copierBandeTuile(bande, tuile, tx, cote, true);
+			r = ecrireTuile(fp, e, tx, ty, tuile);
+		}
+	}
+	if (r == PNM_OK && !ecrireEnteteTuiles(fp, e))
+	{
+		r = PNM_ERREUR_DONNEES;
+	}
+	fclose(fp);
+	if (r != PNM_OK || !remplacerFichier(temporaire, fichiertuiles))
+	{
+		remove(temporaire);
+		return r != PNM_OK ? r : PNM_ERREUR_OUVERTURE;
+	}
+	return PNM_OK;
+}
+
+// Reconstitue une image PNM binaire  partir d'un fichier tuil, une range de tuiles  la fois
+int convertirTuilesVersPNM(const char *fichiertuiles, const char *fichierpnm)
+{
+	FILE *fp;
+	if (fopen_s(&fp, fichiertuiles, "rb") != 0 || !fp)
+	{
+		return PNM_ERREUR_OUVERTURE;
+	}
+	EnteteTuiles e;
+	int r = lireEnteteTuiles(fp, e);
+	if (r != PNM_OK)
+	{
+		fclose(fp);
+		return r;
+	}
+	char temporaire[1024];
+	nomTemporaire(temporaire, sizeof(temporaire), fichierpnm);
+	FILE *sortie;
+	if (fopen_s(&sortie, temporaire, "wb") != 0 || !sortie)
+	{
+		fclose(fp);
+		return PNM_ERREUR_OUVERTURE;
+	}
+	int format = e.canaux == 1 ? 5 : (e.canaux == 3 ? 6 : 7);
+	if (format == 7)
+	{
+		fprintf(sortie, "P7\nWIDTH %ld\nHEIGHT %ld\nDEPTH %d\nMAXVAL %d\nENDHDR\n", e.largeur, e.hauteur, e.canaux, e.maxval);
+	}
+	else
+	{
+		fprintf(sortie, "P%d\n%ld %ld\n%d\n", format, e.largeur, e.hauteur, e.maxval);
+	}
+
+	int largeur = octetsEchantillonTuiles(e);
+	ImagePNM16 bande, tuile;
+	bande.entete.largeur = e.largeur;
+	bande.entete.canaux = e.canaux;
+	vector<unsigned char> octets;
+	for (long ty = 0; ty < e.nbtuilesy && r == PNM_OK; ty++)
+	{
+		bande.entete.hauteur = (ty + 1) * e.cote > e.hauteur ? e.hauteur - ty * e.cote : e.cote;
+		bande.donnees.resize((size_t)bande.entete.hauteur * e.largeur * e.canaux);
+		for (long tx = 0; tx < e.nbtuilesx && r == PNM_OK; tx++)
+		{
+			if ((r = lireTuile(fp, e, tx, ty, tuile)) == PNM_OK)
+			{
+				copierBandeTuile(bande, tuile, tx, e.cote, false);
+			}
+		}
+		// Les fichiers PNM rangent les chantillons de 16 bits octet de poids fort en premier
+		octets.resize(bande.donnees.size() * largeur);
+		for (size_t n = 0; n < bande.donnees.size(); n++)
+		{
+			if (largeur == 2)
+			{
+				octets[2 * n] = (unsigned char)(bande.donnees[n] >> 8);
+				octets[2 * n + 1] = (unsigned char)bande.donnees[n];
+			}
+			else
+			{
+				octets[n] = (unsigned char)bande.donnees[n];
+			}
+		}
+		if (r == PNM_OK && fwrite(&octets[0], 1, octets.size(), sortie) != octets.size())
+		{
+			r = PNM_ERREUR_DONNEES;
+		}
+	}
+	fclose(fp);
+	if (fclose(sortie) != 0 && r == PNM_OK)
+	{
+		r = PNM_ERREUR_DONNEES;
+	}
+	if (r != PNM_OK || !remplacerFichier(temporaire, fichierpnm))
+	{
+		remove(temporaire);
+		return r != PNM_OK ? r : PNM_ERREUR_OUVERTURE;
+	}
+	return PNM_OK;
+}
+
+// Applique traitement(tuile, tx, ty)  une liste de tuiles d'un fichier tuil, en parallle sur nbthreads threads
+// Chaque thread ouvre le fichier de son ct, lit ses tuiles, les traite et les rcrit si traitement renvoie vrai ; les autres tuiles ne sont pas touches
+// Si source est donn (fichier tuil de mme gomtrie), les tuiles sont lues dans source et crites dans fichiertuiles
+// Renvoie PNM_OK ou le premier code d'erreur rencontr
+template <typename Traitement> int traiterTuiles(const char *fichiertuiles, const vector<pair<long, long> > &tuiles, int nbthreads, Traitement traitement, const char *source = NULL)
+{
+	FILE *fp;
+	if (fopen_s(&fp, fichiertuiles, "rb") != 0 || !fp)
+	{
+		return PNM_ERREUR_OUVERTURE;
+	}
+	EnteteTuiles e;
+	int r = lireEnteteTuiles(fp, e);
+	fclose(fp);
+	if (r != PNM_OK)
+	{
+		return r;
+	}
+	EnteteTuiles es = e;
+	if (source != NULL)
+	{
+		if (fopen_s(&fp, source, "rb") != 0 || !fp)
+		{
+			return PNM_ERREUR_OUVERTURE;
+		}
+		r = lireEnteteTuiles(fp, es);
+		fclose(fp);
+		if (r != PNM_OK)
+		{
+			return r;
+		}
+		if (es.largeur != e.largeur || es.hauteur != e.hauteur || es.canaux != e.canaux || es.maxval != e.maxval || es.cote != e.cote)
+		{
+			return PNM_ERREUR_ENTETE;
+		}
+	}
+	if (nbthreads <= 0)
+	{
+		nbthreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	}
+
+	atomic<size_t> prochain(0);
+	atomic<int> erreur(PNM_OK);
+	auto travail = [&]()
+	{
+		FILE *f, *fs = NULL;
+		if (fopen_s(&f, fichiertuiles, "r+b") != 0 || !f)
+		{
+			erreur = PNM_ERREUR_OUVERTURE;
+			return;
+		}
+		if (source != NULL && (fopen_s(&fs, source, "rb") != 0 || !fs))
+		{
+			fclose(f);
+			erreur = PNM_ERREUR_OUVERTURE;
+			return;
+		}
+		// Chaque thread a sa copie de l'index : il ne met  jour que les entres de ses propres tuiles
+		EnteteTuiles local = e;
+		ImagePNM16 tuile;
+		size_t n;
+		while (erreur == PNM_OK && (n = prochain.fetch_add(1)) < tuiles.size())
+		{
+			long tx = tuiles[n].first, ty = tuiles[n].second;
+			int res = fs ? lireTuile(fs, es, tx, ty, tuile) : lireTuile(f, local, tx, ty, tuile);
+			if (res == PNM_OK && traitement(tuile, tx, ty))
+			{
+				res = ecrireTuile(f, local, tx, ty, tuile);
+			}
+			if (res != PNM_OK)
+			{
+				erreur = res;
+			}
+		}
+		if (fs)
+		{
+			fclose(fs);
+		}
+		fclose(f);
+	};
+	vector<thread> threads;
+	for (int t = 1; t < nbthreads; t++)
+	{
+		threads.push_back(thread(travail));
+	}
+	travail();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+	return erreur;
+}
+
+// Une criture de la charge dans un pixel, relative  l'image propre : la composante reoit delta (born  [0, maxval]),
+// puis ses nbbits bits de poids faible sont remplacs par bitsbas si nbbits > 0
+typedef struct {
+	long i, j;
+	int canal;
+	int delta;
+	int nbbits, bitsbas;
+} EcriturePixel;
+
+// critures faites par dissimulationChaineCaracDansPGM (exercice 3) pour une chaine de 8 caractres
+// Renvoie false, avec les mmes messages, si dissimulationChaineCaracDansPGM refuserait ce placement dans une image rows * cols
+// ou si le carr de 8 * 8 (lignes x  x + 7, colonnes y  y + 7) sortirait de l'image
+bool dispositionChaineCarac(long rows, long cols, int a, int x, int y, string texteacacher, vector<EcriturePixel> &ecritures)
+{
+	ecritures.clear();
+	if (x + 8 >= cols || y + 8 >= rows)
+	{
+		cout << "Debut du carre trop loin par rapport  la taille de l'image" << endl;
+		return false;
+	}
+	else if (x < 0 || y < 0 || x + 8 > rows || y + 8 > cols)
+	{
+		cout << "En dehors de l'image" << endl;
+		return false;
+	}
+	if (a == 0)
+	{
+		cout << "Constante ne doit pas etre nulle" << endl;
+		return false;
+	}
+	if (texteacacher.size() < 8)
+	{
+		cout << "La chaine doit faire 8 caracteres" << endl;
+		return false;
+	}
+	for (int i = x; i < x + 8; i++)
+	{
+		for (int j = y; j < y + 8; j++)
+		{
+			EcriturePixel e = { i, j, 0, a * wByte((i - x) * 8 + (j - y), texteacacher), 0, 0 };
+			ecritures.push_back(e);
+		}
+	}
+	return true;
+}
+
+// critures faites par dissimulationTexteDansPGM (exercice 2), mmes pixels et mme dcoupage 2-2-2-2
+// Renvoie false si le texte ne peut pas tre cach dans une image rows * cols avec la constante k
+bool dispositionTexte(long rows, long cols, int k, string texteacacher, vector<EcriturePixel> &ecritures)
+{
+	ecritures.clear();
+	vector<pair<long, long> > positions;
+	if (!positionsTexteDansPGM(rows, cols, k, texteacacher, positions))
+	{
+		return false;
+	}
+	for (size_t n = 0; n < positions.size(); n++)
+	{
+		unsigned char octets[DecoupageTexte::nbcomposantes] = { 0 };
+		DecoupageTexte::cacher((unsigned char)texteacacher[n], octets);
+		for (int c = 0; c < DecoupageTexte::nbcomposantes; c++)
+		{
+			EcriturePixel e = { positions[n].first, positions[n].second + c, 0, 0, 2, octets[c] };
+			ecritures.push_back(e);
+		}
+	}
+	return true;
+}
+
+// Applique  une tuile (tx, ty) de ct cote les critures qui tombent dedans, sur les valeurs propres de la tuile
+// Les critures hors de l'image largeur * hauteur sont ignores : elles tomberaient dans le remplissage des tuiles du bord
+template <typename T> void appliquerEcritures(ImagePNMT<T> &tuile, long tx, long ty, int cote, long largeur, long hauteur, const vector<EcriturePixel> &ecritures)
+{
+	const EntetePNM &e = tuile.entete;
+	for (size_t n = 0; n < ecritures.size(); n++)
+	{
+		const EcriturePixel &w = ecritures[n];
+		if (w.i < 0 || w.j < 0 || w.i >= hauteur || w.j >= largeur || w.canal < 0)
+		{
+			continue;
+		}
+		if (w.i / cote != ty || w.j / cote != tx || w.canal >= e.canaux)
+		{
+			continue;
+		}
+		T &v = tuile.donnees[((w.i % cote) * cote + (w.j % cote)) * e.canaux + w.canal];
+		int tmp = v + w.delta;
+		tmp = tmp < 0 ? 0 : (tmp > e.maxval ? e.maxval : tmp);
+		if (w.nbbits > 0)
+		{
+			int masque = (1 << w.nbbits) - 1;
+			tmp = (tmp & ~masque) | (w.bitsbas & masque);
+		}
+		v = (T)tmp;
+	}
+}
+
+// Tuiles dont le contenu diffre entre deux dispositions de charge : pixels crits par l'une seulement, ou crits diffremment
+void tuilesModifiees(const vector<EcriturePixel> &ancienne, const vector<EcriturePixel> &nouvelle, int cote, vector<pair<long, long> > &tuiles)
+{
+	typedef pair<pair<long, long>, int> Position;
+	auto cle = [](const EcriturePixel &w) { return make_pair(make_pair(w.i, w.j), w.canal); };
+	auto egales = [](const EcriturePixel &a, const EcriturePixel &b) { return a.delta == b.delta && a.nbbits == b.nbbits && (a.nbbits == 0 || a.bitsbas == b.bitsbas); };
+
+	vector<pair<Position, size_t> > a, b;
+	for (size_t n = 0; n < ancienne.size(); n++)
+	{
+		a.push_back(make_pair(cle(ancienne[n]), n));
+	}
+	for (size_t n = 0; n < nouvelle.size(); n++)
+	{
+		b.push_back(make_pair(cle(nouvelle[n]), n));
+	}
+	sort(a.begin(), a.end());
+	sort(b.begin(), b.end());
+
+	// Parcours des deux listes tries en mme temps
+	tuiles.clear();
+	size_t ia = 0, ib = 0;
+	while (ia < a.size() || ib < b.size())
+	{
+		const EcriturePixel *sale = NULL;
+		if (ib == b.size() || (ia < a.size() && a[ia].first < b[ib].first))
+		{
+			sale = &ancienne[a[ia++].second];
+		}
+		else if (ia == a.size() || b[ib].first < a[ia].first)
+		{
+			sale = &nouvelle[b[ib++].second];
+		}
+		else
+		{
+			if (!egales(ancienne[a[ia].second], nouvelle[b[ib].second]))
+			{
+				sale = &nouvelle[b[ib].second];
+			}
+			ia++;
+			ib++;
+		}
+		if (sale)
+		{
+			tuiles.push_back(make_pair(sale->j / cote, sale->i / cote));
+		}
+	}
+	sort(tuiles.begin(), tuiles.end());
+	tuiles.erase(unique(tuiles.begin(), tuiles.end()), tuiles.end());
+}
+
+// Copie un fichier, par blocs
+static bool copierFichier(const char *source, const char *destination)
+{
+	FILE *fs, *fd;
+	if (fopen_s(&fs, source, "rb") != 0 || !fs)
+	{
+		return false;
+	}
+	if (fopen_s(&fd, destination, "wb") != 0 || !fd)
+	{
+		fclose(fs);
+		return false;
+	}
+	vector<unsigned char> tampon(1 << 20);
+	size_t n;
+	bool ok = true;
+	while (ok && (n = fread(&tampon[0], 1, tampon.size(), fs)) > 0)
+	{
+		ok = fwrite(&tampon[0], 1, n, fd) == n;
+	}
+	fclose(fs);
+	return (fclose(fd) == 0) && ok;
+}
+
+// Remarque une image tuile pour un nouveau destinataire : seules les tuiles o l'ancienne et la nouvelle charge diffrent sont
+// recalcules,  partir des tuiles propres du matre, puis rcrites dans le fichier marqu ; le cot suit la taille de la charge, pas celle de l'image
+// Si le fichier marqu n'existe pas, il est cr  partir du matre et l'ancienne disposition doit tre vide. Renvoie PNM_OK ou un code d'erreur
+int remarquageIncremental(const char *maitre, const char *marque, const vector<EcriturePixel> &ancienne, const vector<EcriturePixel> &nouvelle, int nbthreads, long *nbtuiles = NULL)
+{
+	FILE *fp;
+	if (fopen_s(&fp, maitre, "rb") != 0 || !fp)
+	{
+		return PNM_ERREUR_OUVERTURE;
+	}
+	EnteteTuiles e;
+	int r = lireEnteteTuiles(fp, e);
+	fclose(fp);
+	if (r != PNM_OK)
+	{
+		return r;
+	}
+	// Une criture hors de l'image (mme dans le remplissage d'une tuile du bord) est refuse avant de toucher au fichier marqu
+	for (int liste = 0; liste < 2; liste++)
+	{
+		const vector<EcriturePixel> &ecritures = liste == 0 ? ancienne : nouvelle;
+		for (size_t n = 0; n < ecritures.size(); n++)
+		{
+			const EcriturePixel &w = ecritures[n];
+			if (w.i < 0 || w.j < 0 || w.i >= e.hauteur || w.j >= e.largeur || w.canal < 0 || w.canal >= e.canaux)
+			{
+				cout << "En dehors de l'image" << endl;
+				return PNM_ERREUR_DONNEES;
+			}
+		}
+	}
+	if (fopen_s(&fp, marque, "rb") != 0 || !fp)
+	{
+		if (!copierFichier(maitre, marque))
+		{
+			return PNM_ERREUR_OUVERTURE;
+		}
+	}
+	else
+	{
+		fclose(fp);
+	}
+
+	vector<pair<long, long> > tuiles;
+	tuilesModifiees(ancienne, nouvelle, e.cote, tuiles);
+	if (nbtuiles)
+	{
+		*nbtuiles = (long)tuiles.size();
+	}
+	int cote = e.cote;
+	return traiterTuiles(marque, tuiles, nbthreads, [&](ImagePNM16 &tuile, long tx, long ty)
+	{
+		appliquerEcritures(tuile, tx, ty, cote, e.largeur, e.hauteur, nouvelle);
+		return true;
+	}, maitre);
+}
+
+// Tables de GF(256) (polynme primitif x^8 + x^4 + x^3 + x^2 + 1, gnrateur 2) pour le code de Reed-Solomon
+// gfExp est double pour viter le modulo 255 dans les produits
+static unsigned char gfExp[512];
+static unsigned char gfLog[256];
+
+static void initialiserGF256()
+{
+	static const bool initialise = []()
+	{
+		unsigned x = 1;
+		for (int i = 0; i < 255; i++)
+		{
+			gfExp[i] = (unsigned char)x;
+			gfLog[x] = (unsigned char)i;
+			x <<= 1;
+			if (x & 0x100)
+			{
+				x ^= 0x11D;
+			}
+		}
+		for (int i = 255; i < 512; i++)
+		{
+			gfExp[i] = gfExp[i - 255];
+		}
+		return true;
+	}();
+	(void)initialise;
+}
+
+static inline unsigned char gfMul(unsigned char a, unsigned char b)
+{
+	return (a && b) ? gfExp[gfLog[a] + gfLog[b]] : 0;
+}
+
+static inline unsigned char gfDiv(unsigned char a, unsigned char b)
+{
+	return a ? gfExp[gfLog[a] + 255 - gfLog[b]] : 0;
+}
+
+// Valeur en x d'un polynme dont le premier coefficient est celui de plus haut degr (Horner)
+static unsigned char gfEvaluer(const unsigned char *p, int n, unsigned char x)
+{
+	unsigned char y = 0;
+	for (int i = 0; i < n; i++)
+	{
+		y = gfMul(y, x) ^ p[i];
+	}
+	return y;
+}
+
+// Encode nbdonnees octets (nbdonnees + nbparite <= 255) : code reoit les donnes suivies des nbparite octets de parit
+void encoderRS(const unsigned char *donnees, int nbdonnees, int nbparite, unsigned char *code)
+{
+	initialiserGF256();
+	// Polynme gnrateur (x - 1)(x - 2)...(x - 2^(nbparite - 1)), plus haut degr en premier
+	vector<unsigned char> g(1, 1);
+	for (int i = 0; i < nbparite; i++)
+	{
+		vector<unsigned char> h(g.size() + 1, 0);
+		for (size_t j = 0; j < g.size(); j++)
+		{
+			h[j] ^= g[j];
+			h[j + 1] ^= gfMul(g[j], gfExp[i]);
+		}
+		g.swap(h);
+	}
+
+	// Reste de la division de donnees * x^nbparite par g
+	vector<unsigned char> reste(nbparite, 0);
+	for (int i = 0; i < nbdonnees; i++)
+	{
+		unsigned char coef = donnees[i] ^ (nbparite ? reste[0] : 0);
+		for (int j = 0; j < nbparite - 1; j++)
+		{
+			reste[j] = reste[j + 1] ^ gfMul(coef, g[j + 1]);
+		}
+		if (nbparite)
+		{
+			reste[nbparite - 1] = gfMul(coef, g[nbparite]);
+		}
+	}
+	memmove(code, donnees, nbdonnees);
+	for (int j = 0; j < nbparite; j++)
+	{
+		code[nbdonnees + j] = reste[j];
+	}
+}
+
+// Corrige sur place un mot de code de n octets dont nbparite de parit (syndromes, Berlekamp-Massey, Chien, Forney)
+// Renvoie le nombre d'octets corrigs (au plus nbparite / 2), ou -1 si le mot n'est pas corrigible
+int decoderRS(unsigned char *code, int n, int nbparite)
+{
+	initialiserGF256();
+	vector<unsigned char> s(nbparite);
+	bool nul = true;
+	for (int i = 0; i < nbparite; i++)
+	{
+		s[i] = gfEvaluer(code, n, gfExp[i]);
+		nul = nul && s[i] == 0;
+	}
+	if (nul)
+	{
+		return 0;
+	}
+
+	// Berlekamp-Massey : polynme localisateur lambda, plus bas degr en premier
+	vector<unsigned char> lambda(nbparite + 1, 0), b(nbparite + 1, 0), t;
+	lambda[0] = b[0] = 1;
+	int l = 0, m = 1;
+	unsigned char bb = 1;
+	for (int r = 0; r < nbparite; r++)
+	{
+		unsigned char d = s[r];
+		for (int i = 1; i <= l; i++)
+		{
+			d ^= gfMul(lambda[i], s[r - i]);
+		}
+		if (d == 0)
+		{
+			m++;
+			continue;
+		}
+		t = lambda;
+		unsigned char coef = gfDiv(d, bb);
+		for (int i = 0; i + m <= nbparite; i++)
+		{
+			lambda[i + m] ^= gfMul(coef, b[i]);
+		}
+		if (2 * l <= r)
+		{
+			l = r + 1 - l;
+			b = t;
+			bb = d;
+			m = 1;
+		}
+		else
+		{
+			m++;
+		}
+	}
+	if (2 * l > nbparite)
+	{
+		return -1;
+	}
+
+	// Omega = S * lambda mod x^nbparite
+	vector<unsigned char> omega(nbparite, 0);
+	for (int i = 0; i < nbparite; i++)
+	{
+		for (int j = 0; j <= i && j <= l; j++)
+		{
+			omega[i] ^= gfMul(s[i - j], lambda[j]);
+		}
+	}
+
+	// Chien : l'octet p porte la puissance e = n - 1 - p, il est faux si lambda(2^-e) = 0 ; Forney donne alors la valeur de l'erreur
+	int trouvees = 0;
+	for (int p = 0; p < n; p++)
+	{
+		int e = n - 1 - p;
+		unsigned char xinv = gfExp[(255 - e) % 255];
+		unsigned char v = 0, derivee = 0, o = 0, puissance = 1;
+		for (int i = 0; i <= l; i++)
+		{
+			v ^= gfMul(lambda[i], puissance);
+			if (i & 1)
+			{
+				derivee ^= gfMul(lambda[i], gfDiv(puissance, xinv));
+			}
+			puissance = gfMul(puissance, xinv);
+		}
+		if (v != 0)
+		{
+			continue;
+		}
+		puissance = 1;
+		for (int i = 0; i < nbparite; i++)
+		{
+			o ^= gfMul(omega[i], puissance);
+			puissance = gfMul(puissance, xinv);
+		}
+		if (derivee == 0)
+		{
+			return -1;
+		}
+		code[p] ^= gfMul(gfExp[e], gfDiv(o, derivee));
+		trouvees++;
+	}
+	if (trouvees != l)
+	{
+		return -1;
+	}
+	for (int i = 0; i < nbparite; i++)
+	{
+		if (gfEvaluer(code, n, gfExp[i]) != 0)
+		{
+			return -1;
+		}
+	}
+	return trouvees;
+}
+
+// Charge protge : texte suivi de son CRC-32 (4 octets, petit-boutiste), dcoupe en blocs de Reed-Solomon de mme taille
+//  nbparite octets de parit chacun ; le nombre de blocs ne dpend que de la longueur du texte
+static int nbBlocsCharge(size_t nbtexte, int nbparite)
+{
+	size_t utile = 255 - nbparite;
+	return (int)((nbtexte + 4 + utile - 1) / utile);
+}
+
+size_t longueurChargeCodee(size_t nbtexte, int nbparite)
+{
+	return nbtexte + 4 + nbBlocsCharge(nbtexte, nbparite) * (size_t)nbparite;
+}
+
+void encoderCharge(const string &texte, int nbparite, string &code)
+{
+	vector<unsigned char> donnees(texte.begin(), texte.end());
+	unsigned crc = crc32Octets(donnees.empty() ? NULL : &donnees[0], donnees.size());
+	for (int o = 0; o < 4; o++)
+	{
+		donnees.push_back((unsigned char)(crc >> (8 * o)));
+	}
+	int nbblocs = nbBlocsCharge(texte.size(), nbparite);
+	code.resize(longueurChargeCodee(texte.size(), nbparite));
+	size_t lu = 0, ecrit = 0;
+	for (int b = 0; b < nbblocs; b++)
+	{
+		// Les blocs se partagent les donnes  un octet prs
+		size_t taille = (donnees.size() - lu) / (nbblocs - b);
+		vector<unsigned char> mot(taille + nbparite);
+		encoderRS(&donnees[lu], (int)taille, nbparite, &mot[0]);
+		memcpy(&code[ecrit], &mot[0], mot.size());
+		lu += taille;
+		ecrit += mot.size();
+	}
+}
+
+// Dcode une charge de nbtexte caractres ; renvoie le nombre d'octets corrigs, ou -1 si un bloc n'est pas corrigible ou si le CRC est faux
+int decoderCharge(const string &code, size_t nbtexte, int nbparite, string &texte)
+{
+	if (code.size() < longueurChargeCodee(nbtexte, nbparite))
+	{
+		return -1;
+	}
+	int nbblocs = nbBlocsCharge(nbtexte, nbparite);
+	size_t total = nbtexte + 4, lu = 0, ecrit = 0;
+	vector<unsigned char> donnees(total);
+	int corrections = 0;
+	for (int b = 0; b < nbblocs; b++)
+	{
+		size_t taille = (total - ecrit) / (nbblocs - b);
+		vector<unsigned char> mot(code.begin() + lu, code.begin() + lu + taille + nbparite);
+		int r = decoderRS(&mot[0], (int)mot.size(), nbparite);
+		if (r < 0)
+		{
+			return -1;
+		}
+		corrections += r;
+		memcpy(&donnees[ecrit], &mot[0], taille);
+		lu += mot.size();
+		ecrit += taille;
+	}
+	unsigned crc = 0;
+	for (int o = 0; o < 4; o++)
+	{
+		crc |= (unsigned)donnees[nbtexte + o] << (8 * o);
+	}
+	if (crc != crc32Octets(&donnees[0], nbtexte))
+	{
+		return -1;
+	}
+	texte.assign(donnees.begin(), donnees.begin() + nbtexte);
+	return corrections;
+}
+
+// Dcode un lot de charges en parallle sur nbthreads threads ; etats[n] reoit le rsultat de decoderCharge pour codes[n]
+void decoderChargesLot(const vector<string> &codes, size_t nbtexte, int nbparite, int nbthreads, vector<string> &textes, vector<int> &etats)
+{
+	initialiserGF256();
+	textes.assign(codes.size(), string());
+	etats.assign(codes.size(), -1);
+	if (nbthreads <= 0)
+	{
+		nbthreads = thread::hardware_concurrency();
+	}
+	if (nbthreads <= 0)
+	{
+		nbthreads = 1;
+	}
+	atomic<size_t> prochain(0);
+	auto travail = [&]()
+	{
+		size_t n;
+		while ((n = prochain.fetch_add(1)) < codes.size())
+		{
+			etats[n] = decoderCharge(codes[n], nbtexte, nbparite, textes[n]);
+		}
+	};
+	vector<thread> threads;
+	for (int t = 1; t < nbthreads; t++)
+	{
+		threads.push_back(thread(travail));
+	}
+	travail();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+}
+
+// Dissimule un texte protg par le code correcteur avec le schma de l'exercice 2 (la charge code est suivie de '*')
+void dissimulationTexteProtegeDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int k, const string &texte, int nbparite, const IndexationMarquage *indexation = NULL)
+{
+	string code;
+	encoderCharge(texte, nbparite, code);
+	dissimulationTexteDansPGM(im_gris, rows, cols, k, code + '*', indexation);
+}
+
+// Extrait et corrige un texte de nbtexte caractres dissimul par dissimulationTexteProtegeDansPGM
+// Renvoie le nombre d'octets corrigs, ou -1 si la charge est trop abme
+int extractionTexteProtegeDepuisPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int k, size_t nbtexte, int nbparite, string &texte)
+{
+	string code;
+	extractionTexteDepuisPGM(im_gris, rows, cols, k, (int)longueurChargeCodee(nbtexte, nbparite) + 1, code);
+	return decoderCharge(code, nbtexte, nbparite, texte);
+}
+
+// Mme chose en mode dispers (les octets abms sont alors rpartis sur toute l'image)
+void dissimulationTexteDisperseeProtegeDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, unsigned long long cle, const string &texte, int nbparite, const IndexationMarquage *indexation = NULL)
+{
+	string code;
+	encoderCharge(texte, nbparite, code);
+	dissimulationTexteDisperseeDansPGM(im_gris, rows, cols, cle, code + '*', indexation);
+}
+
+int extractionTexteDisperseeProtegeDepuisPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, unsigned long long cle, size_t nbtexte, int nbparite, string &texte)
+{
+	string code;
+	extractionTexteDisperseeDepuisPGM(im_gris, rows, cols, cle, (int)longueurChargeCodee(nbtexte, nbparite) + 1, code);
+	return decoderCharge(code, nbtexte, nbparite, texte);
+}
+
+// Excute travail(n) pour n dans [0, nb[ sur nbthreads threads (les passes des transformes 2D)
+template <typename Travail> static void executerEnParallele(size_t nb, int nbthreads, Travail travail)
+{
+	if (nbthreads <= 0)
+	{
+		nbthreads = thread::hardware_concurrency();
+	}
+	if (nbthreads <= 0)
+	{
+		nbthreads = 1;
+	}
+	atomic<size_t> prochain(0);
+	auto boucle = [&]()
+	{
+		size_t n;
+		while ((n = prochain.fetch_add(1)) < nb)
+		{
+			travail(n);
+		}
+	};
+	vector<thread> threads;
+	for (int t = 1; t < nbthreads && (size_t)t < nb; t++)
+	{
+		threads.push_back(thread(boucle));
+	}
+	boucle();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+}
+
+// Tables d'une FFT de taille n (puissance de 2) : racines exp(-2 i pi k / n) pour k < n / 2 et permutation bit  bit
+typedef struct {
+	int n;
+	vector<complex<double> > racines;
+	vector<int> inversion;
+} TableFFT;
+
+// Tables calcules une seule fois par taille et partages entre threads
+const TableFFT &tableFFT(int n)
+{
+	static mutex verrou;
+	static TableFFT *tables[31] = { NULL };
+	int lg = 0;
+	while ((1 << lg) < n)
+	{
+		lg++;
+	}
+	lock_guard<mutex> garde(verrou);
+	if (!tables[lg])
+	{
+		TableFFT *t = new TableFFT;
+		t->n = n;
+		t->racines.resize(n / 2 > 0 ? n / 2 : 1);
+		for (int k = 0; k < n / 2; k++)
+		{
+			t->racines[k] = polar(1.0, -2.0 * M_PI * k / n);
+		}
+		t->inversion.resize(n);
+		for (int k = 0; k < n; k++)
+		{
+			int r = 0;
+			for (int b = 0; b < lg; b++)
+			{
+				r |= ((k >> b) & 1) << (lg - 1 - b);
+			}
+			t->inversion[k] = r;
+		}
+		tables[lg] = t;
+	}
+	return *tables[lg];
+}
+
+// FFT complexe sur place de taille n (puissance de 2), radix 2 ; l'inverse n'est pas normalise
+void fft(complex<double> *a, int n, bool inverse)
+{
+	const TableFFT &t = tableFFT(n);
+	for (int k = 0; k < n; k++)
+	{
+		if (k < t.inversion[k])
+		{
+			swap(a[k], a[t.inversion[k]]);
+		}
+	}
+	for (int longueur = 2; longueur <= n; longueur <<= 1)
+	{
+		int moitie = longueur / 2, pas = n / longueur;
+		for (int debut = 0; debut < n; debut += longueur)
+		{
+			for (int k = 0; k < moitie; k++)
+			{
+				complex<double> w = inverse ? conj(t.racines[k * pas]) : t.racines[k * pas];
+				complex<double> u = a[debut + k], v = a[debut + k + moitie] * w;
+				a[debut + k] = u + v;
+				a[debut + k + moitie] = u - v;
+			}
+		}
+	}
+}
+
+// FFT d'un signal rel de taille n par une FFT complexe de taille n / 2 : sortie reoit les n / 2 + 1 premiers coefficients
+void fftReelle(const double *x, int n, complex<double> *sortie)
+{
+	int m = n / 2;
+	vector<complex<double> > z(m);
+	for (int k = 0; k < m; k++)
+	{
+		z[k] = complex<double>(x[2 * k], x[2 * k + 1]);
+	}
+	fft(&z[0], m, false);
+	const TableFFT &t = tableFFT(n);
+	for (int k = 0; k <= m; k++)
+	{
+		complex<double> zk = z[k % m], zc = conj(z[(m - k) % m]);
+		complex<double> pair = 0.5 * (zk + zc), impair = complex<double>(0.0, -0.5) * (zk - zc);
+		sortie[k] = pair + (k < m ? t.racines[k] : complex<double>(-1.0, 0.0)) * impair;
+	}
+}
+
+// Inverse de fftReelle (normalise) : reconstruit les n chantillons rels  partir des n / 2 + 1 premiers coefficients
+void fftReelleInverse(const complex<double> *spectre, int n, double *x)
+{
+	int m = n / 2;
+	const TableFFT &t = tableFFT(n);
+	vector<complex<double> > z(m);
+	for (int k = 0; k < m; k++)
+	{
+		complex<double> a = spectre[k], b = conj(spectre[m - k]);
+		complex<double> pair = 0.5 * (a + b), impair = 0.5 * (a - b) * conj(t.racines[k]);
+		z[k] = pair + complex<double>(0.0, 1.0) * impair;
+	}
+	fft(&z[0], m, true);
+	for (int k = 0; k < m; k++)
+	{
+		x[2 * k] = z[k].real() / m;
+		x[2 * k + 1] = z[k].imag() / m;
+	}
+}
+
+// FFT 2D d'une image relle h * w (puissances de 2) : spectre reoit h lignes de w / 2 + 1 coefficients
+// Les lignes puis les colonnes sont rparties sur nbthreads threads
+void fft2DReelle(const double *image, int h, int w, vector<complex<double> > &spectre, int nbthreads)
+{
+	int l = w / 2 + 1;
+	spectre.resize((size_t)h * l);
+	executerEnParallele(h, nbthreads, [&](size_t i)
+	{
+		fftReelle(image + i * w, w, &spectre[i * l]);
+	});
+	executerEnParallele(l, nbthreads, [&](size_t j)
+	{
+		vector<complex<double> > colonne(h);
+		for (int i = 0; i < h; i++)
+		{
+			colonne[i] = spectre[(size_t)i * l + j];
+		}
+		fft(&colonne[0], h, false);
+		for (int i = 0; i < h; i++)
+		{
+			spectre[(size_t)i * l + j] = colonne[i];
+		}
+	});
+}
+
+// Inverse de fft2DReelle (normalise) ; le spectre est modifi
+void fft2DReelleInverse(vector<complex<double> > &spectre, int h, int w, double *image, int nbthreads)
+{
+	int l = w / 2 + 1;
+	executerEnParallele(l, nbthreads, [&](size_t j)
+	{
+		vector<complex<double> > colonne(h);
+		for (int i = 0; i < h; i++)
+		{
+			colonne[i] = spectre[(size_t)i * l + j];
+		}
+		fft(&colonne[0], h, true);
+		for (int i = 0; i < h; i++)
+		{
+			spectre[(size_t)i * l + j] = colonne[i] / (double)h;
+		}
+	});
+	executerEnParallele(h, nbthreads, [&](size_t i)
+	{
+		fftReelleInverse(&spectre[i * l], w, image + i * w);
+	});
+}
+
+// Marque de Fourier-Mellin : un motif angulaire tir de la cl module l'amplitude du spectre sur un anneau de frquences moyennes
+// Une rotation de l'image fait tourner le motif (dcalage circulaire en angle), un changement d'chelle dplace l'anneau en rayon ;
+// le dtecteur somme le spectre en coordonnes log-polaires sur le rayon puis corrle sur tous les dcalages angulaires
+#define FM_NBANGLES 180
+#define FM_ANNEAU_MIN 0.10
+#define FM_ANNEAU_MAX 0.25
+#define FM_DETECTION_MIN 0.06
+#define FM_DETECTION_MAX 0.38
+#define FM_NBRAYONS 64
+
+// Motif +1 / -1 par secteur angulaire de [0, pi[
+static void motifFourierMellin(unsigned long long cle, vector<double> &motif)
+{
+	motif.resize(FM_NBANGLES);
+	for (int a = 0; a < FM_NBANGLES; a++)
+	{
+		motif[a] = (aleatoire64(cle, a) & 1) ? 1.0 : -1.0;
+	}
+}
+
+// Plus grand carr centr de ct puissance de 2 ; renvoie son ct (0 si l'image est trop petite)
+static int carreCentreFFT(const EntetePNM &e, long &ligne0, long &col0)
+{
+	long cote = 1;
+	while (cote * 2 <= e.largeur && cote * 2 <= e.hauteur)
+	{
+		cote *= 2;
+	}
+	ligne0 = (e.hauteur - cote) / 2;
+	col0 = (e.largeur - cote) / 2;
+	return cote >= 64 ? (int)cote : 0;
+}
+
+// Dissimule le motif de la cl dans la composante canal : l'amplitude des coefficients de l'anneau est multiplie par 1 + force * motif
+// (force de l'ordre de 0.2  0.4), la phase est conserve. Renvoie PNM_OK ou PNM_ERREUR_DONNEES si l'image est trop petite
+template <typename T> int dissimulationFourierMellin(ImagePNMT<T> &image, int canal, unsigned long long cle, double force, int nbthreads, const IndexationMarquage *indexation = NULL)
+{
+	const EntetePNM &e = image.entete;
+	long ligne0, col0;
+	int n = carreCentreFFT(e, ligne0, col0);
+	if (n == 0 || canal < 0 || canal >= e.canaux)
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+	vector<double> motif;
+	motifFourierMellin(cle, motif);
+
+	vector<double> carre((size_t)n * n);
+	for (long i = 0; i < n; i++)
+	{
+		for (long j = 0; j < n; j++)
+		{
+			carre[i * n + j] = image.donnees[((ligne0 + i) * e.largeur + col0 + j) * e.canaux + canal];
+		}
+	}
+	vector<complex<double> > spectre;
+	fft2DReelle(&carre[0], n, n, spectre, nbthreads);
+
+	int l = n / 2 + 1;
+	double rmin = FM_ANNEAU_MIN * n, rmax = FM_ANNEAU_MAX * n;
+	for (int i = 0; i < n; i++)
+	{
+		int v = i < n / 2 ? i : i - n;
+		for (int u = 0; u < l; u++)
+		{
+			double r = sqrt((double)u * u + (double)v * v);
+			if (r < rmin || r > rmax)
+			{
+				continue;
+			}
+			double theta = atan2((double)v, (double)u);
+			if (theta < 0)
+			{
+				theta += M_PI;
+			}
+			int a = (int)(theta / M_PI * FM_NBANGLES) % FM_NBANGLES;
+			spectre[(size_t)i * l + u] *= 1.0 + force * motif[a];
+		}
+	}
+	fft2DReelleInverse(spectre, n, n, &carre[0], nbthreads);
+
+	for (long i = 0; i < n; i++)
+	{
+		for (long j = 0; j < n; j++)
+		{
+			double x = floor(carre[i * n + j] + 0.5);
+			image.donnees[((ligne0 + i) * e.largeur + col0 + j) * e.canaux + canal] = (T)(x < 0 ? 0 : (x > e.maxval ? e.maxval : x));
+		}
+	}
+	if (indexation)
+	{
+		char parametres[128];
+		snprintf(parametres, sizeof(parametres), "cle=%llx canal=%d force=%.2f", cle, canal, force);
+		indexerPNM(indexation->nomindex, image, "fourier-mellin", parametres, indexation->fichier);
+	}
+	return PNM_OK;
+}
+
+// Cherche le motif de la cl dans la composante canal, quelles que soient la rotation et l'chelle de l'image
+// correlation reoit la meilleure corrlation normalise (0.2  0.3 sans marque, au-dessus de 0.4 pour une image marque avec force 0.3)
+// et angle la rotation correspondante en degrs (modulo 180). Renvoie PNM_OK ou PNM_ERREUR_DONNEES si l'image est trop petite
+template <typename T> int detectionFourierMellin(const ImagePNMT<T> &image, int canal, unsigned long long cle, int nbthreads, double &correlation, double &angle)
+{
+	const EntetePNM &e = image.entete;
+	long ligne0, col0;
+	int n = carreCentreFFT(e, ligne0, col0);
+	correlation = 0;
+	angle = 0;
+	if (n == 0 || canal < 0 || canal >= e.canaux)
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+
+	// Carr centr, moyenne retire et fentre de Hann pour effacer la croix due aux bords
+	vector<double> fenetre(n), carre((size_t)n * n);
+	for (int k = 0; k < n; k++)
+	{
+		fenetre[k] = 0.5 - 0.5 * cos(2.0 * M_PI * k / n);
+	}
+	double moyenne = 0;
+	for (long i = 0; i < n; i++)
+	{
+		for (long j = 0; j < n; j++)
+		{
+			carre[i * n + j] = image.donnees[((ligne0 + i) * e.largeur + col0 + j) * e.canaux + canal];
+			moyenne += carre[i * n + j];
+		}
+	}
+	moyenne /= (double)n * n;
+	for (long i = 0; i < n; i++)
+	{
+		for (long j = 0; j < n; j++)
+		{
+			carre[i * n + j] = (carre[i * n + j] - moyenne) * fenetre[i] * fenetre[j];
+		}
+	}
+	vector<complex<double> > spectre;
+	fft2DReelle(&carre[0], n, n, spectre, nbthreads);
+
+	int l = n / 2 + 1;
+	vector<double> amplitude(spectre.size());
+	for (size_t k = 0; k < spectre.size(); k++)
+	{
+		amplitude[k] = log(1.0 + abs(spectre[k]));
+	}
+	// Amplitude en (u, v) centrs, par symtrie hermitienne pour u < 0
+	auto lireAmplitude = [&](int u, int v)
+	{
+		if (u < 0)
+		{
+			u = -u;
+			v = -v;
+		}
+		return amplitude[(size_t)((v + n) % n) * l + u];
+	};
+
+	// Rchantillonnage log-polaire, somm sur le rayon : un profil par angle
+	vector<double> profil(FM_NBANGLES, 0.0);
+	executerEnParallele(FM_NBANGLES, nbthreads, [&](size_t a)
+	{
+		double theta = (a + 0.5) * M_PI / FM_NBANGLES, somme = 0;
+		for (int r = 0; r < FM_NBRAYONS; r++)
+		{
+			double rho = FM_DETECTION_MIN * n * pow(FM_DETECTION_MAX / FM_DETECTION_MIN, (double)r / (FM_NBRAYONS - 1));
+			double x = rho * cos(theta), y = rho * sin(theta);
+			int x0 = (int)floor(x), y0 = (int)floor(y);
+			double fx = x - x0, fy = y - y0;
+			somme += (1 - fx) * (1 - fy) * lireAmplitude(x0, y0) + fx * (1 - fy) * lireAmplitude(x0 + 1, y0)
+				+ (1 - fx) * fy * lireAmplitude(x0, y0 + 1) + fx * fy * lireAmplitude(x0 + 1, y0 + 1);
+		}
+		profil[a] = somme;
+	});
+
+	// Retire la tendance lente du profil (anisotropie propre  l'image) avant la corrlation
+	vector<double> detail(FM_NBANGLES), motif;
+	for (int a = 0; a < FM_NBANGLES; a++)
+	{
+		double s = 0;
+		for (int d = -4; d <= 4; d++)
+		{
+			s += profil[(a + d + FM_NBANGLES) % FM_NBANGLES];
+		}
+		detail[a] = profil[a] - s / 9.0;
+	}
+	motifFourierMellin(cle, motif);
+	double md = 0, mm = 0;
+	for (int a = 0; a < FM_NBANGLES; a++)
+	{
+		md += detail[a] / FM_NBANGLES;
+		mm += motif[a] / FM_NBANGLES;
+	}
+	double vd = 0, vm = 0;
+	for (int a = 0; a < FM_NBANGLES; a++)
+	{
+		vd += (detail[a] - md) * (detail[a] - md);
+		vm += (motif[a] - mm) * (motif[a] - mm);
+	}
+	if (vd <= 0 || vm <= 0)
+	{
+		return PNM_OK;
+	}
+	correlation = -2;
+	for (int decalage = 0; decalage < FM_NBANGLES; decalage++)
+	{
+		double c = 0;
+		for (int a = 0; a < FM_NBANGLES; a++)
+		{
+			c += (detail[(a + decalage) % FM_NBANGLES] - md) * (motif[a] - mm);
+		}
+		c /= sqrt(vd * vm);
+		if (c > correlation)
+		{
+			correlation = c;
+			angle = decalage * 180.0 / FM_NBANGLES;
+		}
+	}
+	return PNM_OK;
+}
+
+// Pyramide d'images pour la dtection multi-chelle : chaque niveau est la moyenne 2 * 2 du prcdent (filtre bote)
+// Tous les niveaux sont dans un seul tableau (arene), le niveau 0 tant une copie de l'image
+typedef struct {
+	long largeur, hauteur;
+	size_t debut;     // position du niveau dans l'arne, en chantillons
+	double facteur;   // largeur du niveau / largeur de l'image
+} NiveauPyramide;
+
+template <typename T> struct PyramideT {
+	EntetePNM entete;
+	vector<T> arene;
+	vector<NiveauPyramide> niveaux;
+};
+
+// Vue sur un niveau, telle que la reoivent les dtecteurs : echelle convertit les coordonnes de l'image originale (avant rduction)
+// en coordonnes du niveau
+template <typename T> struct VueNiveau {
+	const T *donnees;
+	long largeur, hauteur;
+	int canaux, maxval;
+	double echelle;
+};
+
+// Moyenne 2 * 2 d'un niveau vers le suivant, ligne par ligne : la boucle interne est contigu et sans branche, pour que le compilateur la vectorise
+template <typename T> static void reduireLigne(const T *a, const T *b, long largeur, int canaux, T *sortie)
+{
+	long pas = 2 * canaux;
+	for (long j = 0; j < largeur; j++)
+	{
+		const T *pa = a + j * pas, *pb = b + j * pas;
+		T *ps = sortie + j * canaux;
+		for (int c = 0; c < canaux; c++)
+		{
+			ps[c] = (T)(((unsigned)pa[c] + pa[c + canaux] + pb[c] + pb[c + canaux] + 2) >> 2);
+		}
+	}
+}
+
+// Construit la pyramide jusqu'au niveau dont le plus petit ct descend sous tailleMin (au moins 1 niveau ; tailleMin est ramene  1 au moins)
+template <typename T> void construirePyramide(const ImagePNMT<T> &image, long tailleMin, int nbthreads, PyramideT<T> &pyramide)
+{
+	const EntetePNM &e = image.entete;
+	pyramide.entete = e;
+	pyramide.niveaux.clear();
+
+	// Placement des niveaux, puis une seule allocation. Avec tailleMin <= 0 la boucle ne s'arrterait jamais (0 / 2 = 0)
+	if (tailleMin < 1)
+	{
+		tailleMin = 1;
+	}
+	long l = e.largeur, h = e.hauteur;
+	size_t total = 0;
+	do
+	{
+		NiveauPyramide n = { l, h, total, (double)l / e.largeur };
+		pyramide.niveaux.push_back(n);
+		total += (size_t)l * h * e.canaux;
+		l /= 2;
+		h /= 2;
+	} while (l >= tailleMin && h >= tailleMin);
+	pyramide.arene.resize(total);
+
+	copy(image.donnees.begin(), image.donnees.begin() + (size_t)e.largeur * e.hauteur * e.canaux, pyramide.arene.begin());
+	for (size_t k = 1; k < pyramide.niveaux.size(); k++)
+	{
+		const NiveauPyramide &src = pyramide.niveaux[k - 1], &dst = pyramide.niveaux[k];
+		const T *s = &pyramide.arene[src.debut];
+		T *d = &pyramide.arene[dst.debut];
+		executerEnParallele(dst.hauteur, nbthreads, [&](size_t i)
+		{
+			reduireLigne(s + 2 * i * src.largeur * e.canaux, s + (2 * i + 1) * src.largeur * e.canaux, dst.largeur, e.canaux, d + i * dst.largeur * e.canaux);
+		});
+	}
+}
+
+template <typename T> VueNiveau<T> vueNiveau(const PyramideT<T> &pyramide, int niveau, double echelle)
+{
+	const NiveauPyramide &n = pyramide.niveaux[niveau];
+	VueNiveau<T> v = { &pyramide.arene[n.debut], n.largeur, n.hauteur, pyramide.entete.canaux, pyramide.entete.maxval, echelle * n.facteur };
+	return v;
+}
+
+// chelle candidate de l'image suspecte par rapport  l'original, avec le score du dtecteur
+typedef struct {
+	double echelle;
+	double score;
+	int niveau;
+} CandidatEchelle;
+
+// Pixels que doit garder, sur le niveau choisi, le plus petit dtail dont a besoin le dtecteur
+#define PYRAMIDE_DETAIL_MIN 2.0
+
+// Niveau le plus grossier o un dtail de detail pixels de l'original, rduit d'echelle, fait encore PYRAMIDE_DETAIL_MIN pixels
+template <typename T> static int niveauUtilisable(const PyramideT<T> &pyramide, double echelle, double detail)
+{
+	int niveau = 0;
+	while (niveau + 1 < (int)pyramide.niveaux.size() && detail * echelle * pyramide.niveaux[niveau + 1].facteur >= PYRAMIDE_DETAIL_MIN)
+	{
+		niveau++;
+	}
+	return niveau;
+}
+
+// Recherche grossire puis fine de l'chelle de l'image suspecte (celle de la pyramide) par rapport  l'original
+// Premier passage : nbechelles chelles rparties gomtriquement dans [emin, emax], chacune value sur son niveau le plus grossier utilisable
+// Passages suivants : seules les nbgardes meilleures chelles dont le score atteint la moiti du meilleur sont gardes, puis affines
+// (pas divis par 2) un niveau plus fin. detecteur(vue) renvoie un score, plus grand quand la marque est prsente ; detail est la taille
+// en pixels de l'original du plus petit motif que le dtecteur doit voir. resultats est tri par score dcroissant
+template <typename T, typename Detecteur> void detectionMultiEchelle(const PyramideT<T> &pyramide, double emin, double emax, int nbechelles, int nbpasses, int nbgardes, double detail, Detecteur detecteur, vector<CandidatEchelle> &resultats)
+{
+	resultats.clear();
+	if (nbechelles < 1 || emin <= 0 || emax < emin)
+	{
+		return;
+	}
+	double raison = nbechelles > 1 ? pow(emax / emin, 1.0 / (nbechelles - 1)) : 1.0;
+	auto evaluer = [&](double echelle, int finesse)
+	{
+		int niveau = niveauUtilisable(pyramide, echelle, detail) - finesse;
+		niveau = niveau < 0 ? 0 : niveau;
+		CandidatEchelle c = { echelle, detecteur(vueNiveau(pyramide, niveau, echelle)), niveau };
+		return c;
+	};
+	auto trier = [](vector<CandidatEchelle> &v)
+	{
+		sort(v.begin(), v.end(), [](const CandidatEchelle &a, const CandidatEchelle &b) { return a.score > b.score; });
+	};
+
+	vector<CandidatEchelle> candidats;
+	for (int k = 0; k < nbechelles; k++)
+	{
+		candidats.push_back(evaluer(emin * pow(raison, k), 0));
+	}
+	for (int passe = 1; passe < nbpasses; passe++)
+	{
+		// lagage
+		trier(candidats);
+		double seuil = candidats[0].score > 0 ? candidats[0].score / 2 : candidats[0].score;
+		while (candidats.size() > 1 && ((int)candidats.size() > nbgardes || candidats.back().score < seuil))
+		{
+			candidats.pop_back();
+		}
+		// Affinage autour des survivants
+		double pas = pow(raison, 1.0 / (1 << passe));
+		vector<CandidatEchelle> suivants;
+		for (size_t k = 0; k < candidats.size(); k++)
+		{
+			suivants.push_back(evaluer(candidats[k].echelle, passe));
+			if (candidats[k].echelle / pas >= emin)
+			{
+				suivants.push_back(evaluer(candidats[k].echelle / pas, passe));
+			}
+			if (candidats[k].echelle * pas <= emax)
+			{
+				suivants.push_back(evaluer(candidats[k].echelle * pas, passe));
+			}
+		}
+		candidats.swap(suivants);
+	}
+	trier(candidats);
+	resultats = candidats;
+}
+
+// Adaptateur du patchwork pour detectionMultiEchelle : mmes carrs que detectionPatchworkPNM, placs  l'chelle de la vue
+// largeurorig est la largeur de l'image marque d'origine, qui sert  dcoder les indices de pixel
+template <typename T> double detectionPatchworkVue(const VueNiveau<T> &vue, long largeurorig, long debutcarre1, long debutcarre2, int taillecarres)
+{
+	double sommes[2] = { 0, 0 };
+	long nbs[2] = { 0, 0 };
+	long debuts[2] = { debutcarre1, debutcarre2 };
+	for (int c = 0; c < 2; c++)
+	{
+		long i0 = (long)floor((debuts[c] / largeurorig) * vue.echelle + 0.5), j0 = (long)floor((debuts[c] % largeurorig) * vue.echelle + 0.5);
+		long cote = (long)floor(taillecarres * vue.echelle + 0.5);
+		for (long i = i0; i < i0 + cote && i < vue.hauteur; i++)
+		{
+			if (j0 >= vue.largeur)
+			{
+				break;
+			}
+			const T *ligne = vue.donnees + (i * vue.largeur + j0) * vue.canaux;
+			long nb = (j0 + cote > vue.largeur ? vue.largeur - j0 : cote) * vue.canaux;
+			for (long n = 0; n < nb; n++)
+			{
+				sommes[c] += ligne[n];
+			}
+			nbs[c] += nb;
+		}
+	}
+	if (nbs[0] == 0 || nbs[1] == 0)
+	{
+		return 0;
+	}
+	int unite = (vue.maxval + 1) / 256;
+	return (sommes[1] / nbs[1] - sommes[0] / nbs[0]) / (unite < 1 ? 1 : unite);
+}
+
+// Adaptateur de Fourier-Mellin pour detectionMultiEchelle : la dtection est dj invariante  l'chelle, la pyramide sert  travailler
+// sur le niveau le plus petit qui garde l'anneau marqu sous la bande de dtection (detail = 3 dans detectionMultiEchelle)
+template <typename T> double detectionFourierMellinVue(const VueNiveau<T> &vue, int canal, unsigned long long cle, int nbthreads)
+{
+	ImagePNMT<T> niveau;
+	niveau.entete.format = vue.canaux == 1 ? 5 : 6;
+	niveau.entete.largeur = vue.largeur;
+	niveau.entete.hauteur = vue.hauteur;
+	niveau.entete.canaux = vue.canaux;
+	niveau.entete.maxval = vue.maxval;
+	niveau.entete.debutdonnees = 0;
+	niveau.donnees.assign(vue.donnees, vue.donnees + (size_t)vue.largeur * vue.hauteur * vue.canaux);
+	double correlation, angle;
+	detectionFourierMellin(niveau, canal, cle, nbthreads, correlation, angle);
+	return correlation;
+}
+
+// Fonction gamma incomplte rgularise Q(a, x) = 1 - P(a, x) (srie pour x < a + 1, fraction continue sinon)
+double gammaIncompleteQ(double a, double x)
+{
+	if (x <= 0 || a <= 0)
+	{
+		return 1.0;
+	}
+	double lg = lgamma(a);
+	if (x < a + 1)
+	{
+		double terme = 1.0 / a, somme = terme;
+		for (int n = 1; n < 1000; n++)
+		{
+			terme *= x / (a + n);
+			somme += terme;
+			if (fabs(terme) < fabs(somme) * 1e-15)
+			{
+				break;
+			}
+		}
+		return 1.0 - somme * exp(-x + a * log(x) - lg);
+	}
+	// Lentz
+	const double petit = 1e-300;
+	double b = x + 1 - a, c = 1 / petit, d = 1 / b, h = d;
+	for (int n = 1; n < 1000; n++)
+	{
+		double an = -n * (n - a);
+		b += 2;
+		d = an * d + b;
+		d = fabs(d) < petit ? petit : d;
+		c = b + an / c;
+		c = fabs(c) < petit ? petit : c;
+		d = 1 / d;
+		double delta = d * c;
+		h *= delta;
+		if (fabs(delta - 1) < 1e-15)
+		{
+			break;
+		}
+	}
+	return exp(-x + a * log(x) - lg) * h;
+}
+
+// Test du khi-deux sur les paires de valeurs (2k, 2k + 1) d'un histogramme : probabilit que les paires aient t galises
+// par un remplacement des bits de poids faible (proche de 1 pour une zone entirement remplie, proche de 0 pour une image propre)
+double probabiliteKhiDeux(const vector<unsigned> &histogramme)
+{
+	double khi2 = 0;
+	int nbpaires = 0;
+	for (size_t k = 0; k + 1 < histogramme.size(); k += 2)
+	{
+		double attendu = (histogramme[k] + histogramme[k + 1]) / 2.0;
+		if (attendu < 5)
 		{
-			tmpr += (double)image->data[i * image->x + j].red * cos((startj * M_PI * (2.0 * i + 1.0)) / 2.0 * 8.0) * cos((starti * M_PI * (2.0 * j + 1.0)) / 2.0 * 8.0);
-			tmpg += (double)image->data[i * image->x + j].green * cos((startj * M_PI * (2.0 * i + 1.0)) / 2.0 * 8.0) * cos((starti * M_PI * (2.0 * j + 1.0)) / 2.0 * 8.0);
-			tmpb += (double)image->data[i * image->x + j].blue * cos((startj * M_PI * (2.0 * i + 1.0)) / 2.0 * 8.0) * cos((starti * M_PI * (2.0 * j + 1.0)) / 2.0 * 8.0);
+			continue;
+		}
+		khi2 += (histogramme[k] - attendu) * (histogramme[k] - attendu) / attendu;
+		nbpaires++;
+	}
+	if (nbpaires < 2)
+	{
+		return 0;
+	}
+	return gammaIncompleteQ((nbpaires - 1) / 2.0, khi2 / 2.0);
+}
+
+// Nombre de pas du test du khi-deux sur des prfixes croissants de l'image
+#define KHI2_NBPAS 20
+
+// Khi-deux d'une composante sur des prfixes croissants (ordre des lignes) : pchi2 reoit la probabilit sur toute la composante,
+// taux la part de l'image couverte par le plus long prfixe o la probabilit dpasse 0.5 (remplissage squentiel)
+// L'histogramme est compt dans 4 tableaux entrelacs pour ne pas enchaner les incrments sur la mme case
+template <typename T> void khiDeuxComposante(const ImagePNMT<T> &image, int canal, double &pchi2, double &taux)
+{
+	const EntetePNM &e = image.entete;
+	size_t nbvaleurs = (size_t)e.maxval + 1 + (e.maxval % 2 == 0 ? 1 : 0);
+	vector<unsigned> partiels(4 * nbvaleurs, 0), histogramme(nbvaleurs);
+	size_t nb = (size_t)e.largeur * e.hauteur;
+	const T *p = &image.donnees[canal];
+	size_t n = 0;
+	pchi2 = 0;
+	taux = 0;
+	for (int pas = 1; pas <= KHI2_NBPAS; pas++)
+	{
+		size_t fin = nb * pas / KHI2_NBPAS;
+		for (; n + 4 <= fin; n += 4)
+		{
+			partiels[p[n * e.canaux]]++;
+			partiels[nbvaleurs + p[(n + 1) * e.canaux]]++;
+			partiels[2 * nbvaleurs + p[(n + 2) * e.canaux]]++;
+			partiels[3 * nbvaleurs + p[(n + 3) * e.canaux]]++;
+		}
+		for (; n < fin; n++)
+		{
+			partiels[p[n * e.canaux]]++;
+		}
+		for (size_t v = 0; v < nbvaleurs; v++)
+		{
+			histogramme[v] = partiels[v] + partiels[nbvaleurs + v] + partiels[2 * nbvaleurs + v] + partiels[3 * nbvaleurs + v];
+		}
+		pchi2 = probabiliteKhiDeux(histogramme);
+		if (pchi2 > 0.5 && taux == (double)(pas - 1) / KHI2_NBPAS)
+		{
+			taux = (double)pas / KHI2_NBPAS;
+		}
+	}
+}
+
+// Comptes de l'analyse RS pour un masque : groupes rguliers (la variation augmente) et singuliers (elle diminue)
+typedef struct {
+	long regulier, singulier;
+} ComptesRS;
+
+// Variation d'un groupe de 4 chantillons
+static inline int variationGroupe(int a, int b, int c, int d)
+{
+	return abs(b - a) + abs(c - b) + abs(d - c);
+}
+
+// Analyse RS d'une composante sur des groupes de 4 chantillons conscutifs d'une ligne, masque 0 1 1 0 : F1 change 2k et 2k + 1,
+// F-1 change 2k - 1 et 2k. inverser applique d'abord F1  toute l'image (point p = 1 - p / 2 de l'analyse)
+template <typename T> static void comptesRS(const ImagePNMT<T> &image, int canal, bool inverser, ComptesRS &positif, ComptesRS &negatif)
+{
+	const EntetePNM &e = image.entete;
+	int x = inverser ? 1 : 0;
+	positif.regulier = positif.singulier = negatif.regulier = negatif.singulier = 0;
+	for (long i = 0; i < e.hauteur; i++)
+	{
+		const T *ligne = &image.donnees[(size_t)i * e.largeur * e.canaux + canal];
+		for (long j = 0; j + 4 <= e.largeur; j += 4)
+		{
+			int a = ligne[j * e.canaux] ^ x, b = ligne[(j + 1) * e.canaux] ^ x, c = ligne[(j + 2) * e.canaux] ^ x, d = ligne[(j + 3) * e.canaux] ^ x;
+			int f = variationGroupe(a, b, c, d);
+			int fp = variationGroupe(a, b ^ 1, c ^ 1, d);
+			int fn = variationGroupe(a, ((b + 1) ^ 1) - 1, ((c + 1) ^ 1) - 1, d);
+			positif.regulier += fp > f;
+			positif.singulier += fp < f;
+			negatif.regulier += fn > f;
+			negatif.singulier += fn < f;
+		}
+	}
+}
+
+// Taux d'insertion estim par l'analyse RS (Fridrich, Goljan, Du) : part des chantillons dont le bit de poids faible a t remplac
+template <typename T> double tauxRS(const ImagePNMT<T> &image, int canal)
+{
+	ComptesRS p0, n0, p1, n1;
+	comptesRS(image, canal, false, p0, n0);
+	comptesRS(image, canal, true, p1, n1);
+	double nbgroupes = (double)(image.entete.largeur / 4) * image.entete.hauteur;
+	if (nbgroupes <= 0)
+	{
+		return 0;
+	}
+	double d0 = (p0.regulier - p0.singulier) / nbgroupes, d1 = (p1.regulier - p1.singulier) / nbgroupes;
+	double dn0 = (n0.regulier - n0.singulier) / nbgroupes, dn1 = (n1.regulier - n1.singulier) / nbgroupes;
+	// 2 (d1 + d0) z^2 + (dn0 - dn1 - d1 - 3 d0) z + d0 - dn0 = 0, puis p = z / (z - 1/2)
+	double a = 2 * (d1 + d0), b = dn0 - dn1 - d1 - 3 * d0, c = d0 - dn0, z;
+	if (fabs(a) < 1e-12)
+	{
+		if (fabs(b) < 1e-12)
+		{
+			return 0;
+		}
+		z = -c / b;
+	}
+	else
+	{
+		double delta = b * b - 4 * a * c;
+		if (delta < 0)
+		{
+			delta = 0;
+		}
+		double z1 = (-b + sqrt(delta)) / (2 * a), z2 = (-b - sqrt(delta)) / (2 * a);
+		z = fabs(z1) < fabs(z2) ? z1 : z2;
+	}
+	if (fabs(z - 0.5) < 1e-12)
+	{
+		return 1;
+	}
+	double taux = z / (z - 0.5);
+	return taux < 0 ? 0 : (taux > 1 ? 1 : taux);
+}
+
+// Rsultat de la stganalyse d'une image : maximum sur les composantes
+typedef struct {
+	string fichier;
+	int code;
+	EntetePNM entete;
+	double pchi2;     // probabilit du khi-deux sur toute l'image
+	double tauxchi2;  // part de l'image remplie squentiellement selon le khi-deux
+	double tauxrs;    // taux d'insertion estim par l'analyse RS
+} AnalyseLSB;
+
+void analyserImageLSB(AnalyseLSB &analyse)
+{
+	ImagePNM16 image;
+	analyse.pchi2 = analyse.tauxchi2 = analyse.tauxrs = 0;
+	analyse.code = lirePNM(analyse.fichier.c_str(), image);
+	if (analyse.code != PNM_OK)
+	{
+		return;
+	}
+	analyse.entete = image.entete;
+	for (int c = 0; c < image.entete.canaux; c++)
+	{
+		double p, t;
+		khiDeuxComposante(image, c, p, t);
+		double rs = tauxRS(image, c);
+		analyse.pchi2 = max(analyse.pchi2, p);
+		analyse.tauxchi2 = max(analyse.tauxchi2, t);
+		analyse.tauxrs = max(analyse.tauxrs, rs);
+	}
+}
+
+// Stganalyse des bits de poids faible de toutes les images PNM d'un dossier et de ses sous-dossiers, en parallle
+// crit un rapport (une ligne par image, champs spars par des tabulations) et renvoie le nombre d'images dont le taux RS dpasse seuil
+int steganalyseCorpus(string dossier, string rapport, int nbthreads, double seuil)
+{
+	vector<string> fichiers;
+	listerFichiersPNM(dossier, fichiers);
+	sort(fichiers.begin(), fichiers.end());
+	if (nbthreads <= 0)
+	{
+		nbthreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	}
+
+	vector<AnalyseLSB> analyses(fichiers.size());
+	atomic<size_t> prochain(0);
+	auto travail = [&]()
+	{
+		size_t n;
+		while ((n = prochain.fetch_add(1)) < fichiers.size())
+		{
+			analyses[n].fichier = fichiers[n];
+			analyserImageLSB(analyses[n]);
+		}
+	};
+	vector<thread> threads;
+	for (int t = 1; t < nbthreads; t++)
+	{
+		threads.push_back(thread(travail));
+	}
+	travail();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+
+	ofstream f(rapport.c_str());
+	if (f.fail())
+	{
+		cout << "Impossible d'ecrire le rapport " << rapport << endl;
+		return 0;
+	}
+	f << "# fichier\tformat\tlargeur\thauteur\tcanaux\tpkhi2\ttauxkhi2\ttauxrs\tsuspecte\terreur\n";
+	f << fixed << setprecision(3);
+	int suspectes = 0;
+	for (size_t n = 0; n < analyses.size(); n++)
+	{
+		const AnalyseLSB &a = analyses[n];
+		f << a.fichier << '\t';
+		if (a.code == PNM_OK)
+		{
+			bool suspecte = a.tauxrs > seuil;
+			f << 'P' << a.entete.format << '\t' << a.entete.largeur << '\t' << a.entete.hauteur << '\t' << a.entete.canaux << '\t'
+				<< a.pchi2 << '\t' << a.tauxchi2 << '\t' << a.tauxrs << '\t' << (suspecte ? 1 : 0) << "\t-\n";
+			suspectes += suspecte;
+		}
+		else
+		{
+			f << "-\t0\t0\t0\t0\t0\t0\t0\t" << messageErreurPNM(a.code) << '\n';
+		}
+	}
+	return suspectes;
+}
+
+// Lecture d'images PNM binaires concatnes dans un flux (tube, entre standard ou fichier), l'une aprs l'autre
+// Le tampon est rutilis d'une image  l'autre ; on ne lit jamais au-del de l'image en cours, sauf quelques octets d'en-tte,
+// pour ne pas attendre l'image suivante sur un tube
+typedef struct {
+	FILE *fp;
+	vector<unsigned char> tampon;
+	size_t debut, fin;
+	bool finfichier;
+} LecteurFluxPNM;
+
+// Octets lus d'un coup tant que l'en-tte n'est pas complet
+#define FLUX_BLOC_ENTETE 256
+// Tailles acceptes pour une trame : l'en-tte et la taille des donnes viennent du flux, elles sont bornes avant d'agrandir le tampon
+#define FLUX_TAILLE_MAX_ENTETE (1 << 20)
+#define FLUX_TAILLE_MAX_IMAGE ((unsigned long long)1 << 31)
+
+void ouvrirFluxPNM(LecteurFluxPNM &lecteur, FILE *fp)
+{
+	lecteur.fp = fp;
+	lecteur.tampon.clear();
+	lecteur.debut = lecteur.fin = 0;
+	lecteur.finfichier = false;
+}
+
+// Ajoute jusqu' nb octets du flux  la fin du tampon (finfichier passe  vrai  la fin du flux). Renvoie PNM_OK ou PNM_ERREUR_MEMOIRE
+static int remplirFluxPNM(LecteurFluxPNM &lecteur, size_t nb)
+{
+	if (lecteur.debut > 0)
+	{
+		memmove(lecteur.tampon.data(), lecteur.tampon.data() + lecteur.debut, lecteur.fin - lecteur.debut);
+		lecteur.fin -= lecteur.debut;
+		lecteur.debut = 0;
+	}
+	if (lecteur.tampon.size() < lecteur.fin + nb)
+	{
+		try
+		{
+			lecteur.tampon.resize(lecteur.fin + nb);
+		}
+		catch (const bad_alloc &)
+		{
+			return PNM_ERREUR_MEMOIRE;
+		}
+	}
+	size_t n = fread(&lecteur.tampon[lecteur.fin], 1, nb, lecteur.fp);
+	lecteur.fin += n;
+	if (n < nb)
+	{
+		lecteur.finfichier = true;
+	}
+	return PNM_OK;
+}
+
+// Lit l'image suivante du flux (P5, P6 ou P7). Renvoie PNM_OK, PNM_INCOMPLET  la fin du flux (entre deux images) ou un code d'erreur
+template <typename T> int lireImageFluxPNM(LecteurFluxPNM &lecteur, ImagePNMT<T> &image)
+{
+	EntetePNM e;
+	int r;
+	while (true)
+	{
+		if (lecteur.fin == lecteur.debut && lecteur.finfichier)
+		{
+			return PNM_INCOMPLET;
+		}
+		r = analyserEntetePNM(lecteur.tampon.data() + lecteur.debut, lecteur.fin - lecteur.debut, lecteur.finfichier, e);
+		if (r != PNM_INCOMPLET)
+		{
+			break;
+		}
+		if (lecteur.finfichier || lecteur.fin - lecteur.debut > FLUX_TAILLE_MAX_ENTETE)
+		{
+			return PNM_ERREUR_ENTETE;
+		}
+		if ((r = remplirFluxPNM(lecteur, FLUX_BLOC_ENTETE)) != PNM_OK)
+		{
+			return r;
+		}
+	}
+	if (r != PNM_OK)
+	{
+		return r;
+	}
+	if (e.format != 5 && e.format != 6 && e.format != 7)
+	{
+		// Sans taille fixe, la fin d'une image ASCII ne se repre pas dans un flux
+		return PNM_ERREUR_FORMAT;
+	}
+	unsigned long long taille = (unsigned long long)e.largeur * e.hauteur * e.canaux * (e.maxval > 255 ? 2 : 1);
+	if (taille > FLUX_TAILLE_MAX_IMAGE || taille > (unsigned long long)((size_t)-1) - e.debutdonnees)
+	{
+		return PNM_ERREUR_MEMOIRE;
+	}
+	size_t total = (size_t)e.debutdonnees + (size_t)taille;
+	if (lecteur.fin - lecteur.debut < total && !lecteur.finfichier && (r = remplirFluxPNM(lecteur, total - (lecteur.fin - lecteur.debut))) != PNM_OK)
+	{
+		return r;
+	}
+	if (lecteur.fin - lecteur.debut < total)
+	{
+		return PNM_ERREUR_DONNEES;
+	}
+	r = decoderPNM(lecteur.tampon.data() + lecteur.debut, total, image);
+	lecteur.debut += total;
+	return r;
+}
+
+// crit une image binaire  la suite d'un flux
+template <typename T> int ecrireImageFluxPNM(FILE *fp, const ImagePNMT<T> &image)
+{
+	char tampon[256];
+	vector<unsigned char> octets;
+	MorceauEcriture morceaux[2];
+	encoderPNM(image, tampon, octets, morceaux);
+	for (int m = 0; m < 2; m++)
+	{
+		if (morceaux[m].taille > 0 && fwrite(morceaux[m].debut, 1, morceaux[m].taille, fp) != morceaux[m].taille)
+		{
+			return PNM_ERREUR_OUVERTURE;
+		}
+	}
+	return fflush(fp) == 0 ? PNM_OK : PNM_ERREUR_OUVERTURE;
+}
+
+// Applique traitement(image, cleimage, indice)  chaque image d'un flux d'images PNM concatnes et crit les images dans le mme ordre
+// entree et sortie sont des noms de fichiers, "-" pour l'entre ou la sortie standard ; cleimage est tire de cle et de l'indice de l'image,
+// ce qui rend le marquage de chaque image reproductible quel que soit le thread qui la traite
+// Jusqu' nbenvol images sont en mmoire  la fois (lues, en cours de traitement ou en attente d'criture) : un thread lit, nbthreads traitent,
+// le thread appelant crit dans l'ordre grce  un tampon de rordonnancement ; les images sont rutilises d'une trame  l'autre
+// Renvoie PNM_OK ou le premier code d'erreur rencontr ; nbimages reoit le nombre d'images crites
+template <typename Traitement> int traiterFluxPNM(const char *entree, const char *sortie, unsigned long long cle, int nbthreads, int nbenvol, Traitement traitement, long *nbimages = NULL)
+{
+	FILE *fe = stdin, *fs = stdout;
+	if (strcmp(entree, "-") != 0 && (fopen_s(&fe, entree, "rb") != 0 || !fe))
+	{
+		return PNM_ERREUR_OUVERTURE;
+	}
+	if (strcmp(sortie, "-") != 0 && (fopen_s(&fs, sortie, "wb") != 0 || !fs))
+	{
+		if (fe != stdin)
+		{
+			fclose(fe);
+		}
+		return PNM_ERREUR_OUVERTURE;
+	}
+#ifdef _WIN32
+	// Les flux standard sont en mode texte par dfaut sous Windows
+	if (fe == stdin)
+	{
+		_setmode(_fileno(stdin), _O_BINARY);
+	}
+	if (fs == stdout)
+	{
+		_setmode(_fileno(stdout), _O_BINARY);
+	}
+#endif
+	if (nbthreads <= 0)
+	{
+		nbthreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	}
+	if (nbenvol < 2)
+	{
+		nbenvol = 2;
+	}
+
+	vector<ImagePNM16> images(nbenvol);
+	vector<long> indices(nbenvol, 0);
+	deque<int> libres, atraiter;
+	map<long, int> terminees;
+	for (int k = 0; k < nbenvol; k++)
+	{
+		libres.push_back(k);
+	}
+	mutex verrou;
+	condition_variable signal;
+	bool finlecture = false, arret = false;
+	long nblues = 0;
+	int erreur = PNM_OK;
+
+	// Lecture : une image libre est remplie avec la trame suivante puis confie aux threads de traitement
+	thread lecture([&]()
+	{
+		LecteurFluxPNM lecteur;
+		ouvrirFluxPNM(lecteur, fe);
+		while (true)
+		{
+			int k;
+			{
+				unique_lock<mutex> l(verrou);
+				signal.wait(l, [&]() { return !libres.empty() || arret; });
+				if (arret)
+				{
+					break;
+				}
+				k = libres.front();
+				libres.pop_front();
+			}
+			int r = lireImageFluxPNM(lecteur, images[k]);
+			lock_guard<mutex> l(verrou);
+			if (r != PNM_OK)
+			{
+				if (r != PNM_INCOMPLET && erreur == PNM_OK)
+				{
+					erreur = r;
+				}
+				break;
+			}
+			indices[k] = nblues++;
+			atraiter.push_back(k);
+			signal.notify_all();
+		}
+		lock_guard<mutex> l(verrou);
+		finlecture = true;
+		signal.notify_all();
+	});
+
+	auto travail = [&]()
+	{
+		while (true)
+		{
+			int k;
+			{
+				unique_lock<mutex> l(verrou);
+				signal.wait(l, [&]() { return !atraiter.empty() || finlecture || arret; });
+				if (atraiter.empty() || arret)
+				{
+					return;
+				}
+				k = atraiter.front();
+				atraiter.pop_front();
+			}
+			traitement(images[k], aleatoire64(cle, indices[k]), indices[k]);
+			lock_guard<mutex> l(verrou);
+			terminees[indices[k]] = k;
+			signal.notify_all();
+		}
+	};
+	vector<thread> threads;
+	for (int t = 0; t < nbthreads; t++)
+	{
+		threads.push_back(thread(travail));
+	}
+
+	// criture dans l'ordre des trames
+	long prochaine = 0;
+	while (true)
+	{
+		int k;
+		{
+			unique_lock<mutex> l(verrou);
+			signal.wait(l, [&]() { return terminees.count(prochaine) > 0 || (finlecture && prochaine == nblues); });
+			if (terminees.count(prochaine) == 0)
+			{
+				break;
+			}
+			k = terminees[prochaine];
+			terminees.erase(prochaine);
+		}
+		int r = ecrireImageFluxPNM(fs, images[k]);
+		lock_guard<mutex> l(verrou);
+		if (r != PNM_OK)
+		{
+			if (erreur == PNM_OK)
+			{
+				erreur = r;
+			}
+			arret = true;
+			signal.notify_all();
+			break;
+		}
+		prochaine++;
+		libres.push_back(k);
+		signal.notify_all();
+	}
+
+	lecture.join();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+	if (fe != stdin)
+	{
+		fclose(fe);
+	}
+	if (fs != stdout)
+	{
+		fclose(fs);
+	}
+	if (nbimages)
+	{
+		*nbimages = prochaine;
+	}
+	return erreur;
+}
+
+// Bloc 8 * 8 de l'exercice 3  vrifier : coin (x = ligne, y = colonne) et composante
+typedef struct {
+	long x, y;
+	int canal;
+} PositionChaine;
+
+// Rsultat de la vrification d'une copie suspecte : une chaine par position demande
+typedef struct {
+	string fichier;
+	int code;
+	vector<string> textes;
+} VerificationCopie;
+
+// Dcode les chaines de toutes les positions d'une copie, par signe de la diffrence avec l'originale (mme convention que extractionChaineCaracPNM)
+// Les deux images couvrent les mmes lignes,  partir de la ligne ligne0 de l'image complte
+static void decoderChainesCopie(const ImagePNM16 &orig, const ImagePNM16 &copie, long ligne0, const vector<PositionChaine> &positions, vector<string> &textes)
+{
+	const EntetePNM &e = orig.entete;
+	textes.resize(positions.size());
+	for (size_t p = 0; p < positions.size(); p++)
+	{
+		const PositionChaine &pos = positions[p];
+		textes[p].resize(8);
+		for (long i = 0; i < 8; i++)
+		{
+			size_t debut = ((pos.x - ligne0 + i) * e.largeur + pos.y) * e.canaux + pos.canal;
+			const unsigned short *o = &orig.donnees[debut], *c = &copie.donnees[debut];
+			// Comparaisons sans branche ni division : un bit par pixel
+			unsigned tmptot = 0;
+			for (int j = 0; j < 8; j++)
+			{
+				tmptot |= (unsigned)(c[j * e.canaux] >= o[j * e.canaux]) << (7 - j);
+			}
+			textes[p][i] = (char)tmptot;
+		}
+	}
+}
+
+// Vrifie une srie de copies suspectes contre une mme originale : l'originale n'est lue qu'une fois, chaque copie n'est lue qu'une fois
+// (seulement les lignes qui contiennent les blocs pour les formats binaires), et toutes les chaines d'une copie sont dcodes pendant cette lecture
+// Les copies sont rparties sur nbthreads threads ; si rapport n'est pas vide, une table (une ligne par copie, une colonne par position) y est crite
+// Renvoie PNM_OK, ou le code d'erreur de l'originale ; le code de chaque copie est dans resultats
+int verificationCopies(const char *original, const vector<string> &copies, const vector<PositionChaine> &positions, int nbthreads, vector<VerificationCopie> &resultats, string rapport = "")
+{
+	resultats.assign(copies.size(), VerificationCopie());
+	EntetePNM e;
+	int r = lireEntetePNM(original, e);
+	if (r != PNM_OK)
+	{
+		return r;
+	}
+	long ligne0 = e.hauteur, ligne1 = 0;
+	for (size_t p = 0; p < positions.size(); p++)
+	{
+		const PositionChaine &pos = positions[p];
+		if (pos.x < 0 || pos.y < 0 || pos.x + 8 > e.hauteur || pos.y + 8 > e.largeur || pos.canal < 0 || pos.canal >= e.canaux)
+		{
+			cout << "En dehors de l'image" << endl;
+			return PNM_ERREUR_DONNEES;
+		}
+		ligne0 = min(ligne0, pos.x);
+		ligne1 = max(ligne1, pos.x + 8);
+	}
+	if (positions.empty())
+	{
+		ligne0 = 0;
+		ligne1 = 0;
+	}
+
+	// Bande de lignes utile de l'originale (toute l'image pour les formats ASCII)
+	ImagePNM16 orig;
+	bool partiel = true;
+	if (ligne1 > ligne0)
+	{
+		r = lireZonePNM(original, ligne0, ligne1 - ligne0, 0, e.largeur, orig);
+		if (r == PNM_ERREUR_FORMAT)
+		{
+			partiel = false;
+			r = lirePNM(original, orig);
+		}
+		if (r != PNM_OK)
+		{
+			return r;
+		}
+	}
+	long debutbande = partiel ? ligne0 : 0;
+
+	if (nbthreads <= 0)
+	{
+		nbthreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	}
+	atomic<size_t> prochain(0);
+	auto travail = [&]()
+	{
+		// Une image par thread, rutilise d'une copie  l'autre
+		ImagePNM16 copie;
+		EntetePNM entetecopie;
+		size_t n;
+		while ((n = prochain.fetch_add(1)) < copies.size())
+		{
+			VerificationCopie &v = resultats[n];
+			v.fichier = copies[n];
+			if (ligne1 <= ligne0)
+			{
+				v.code = PNM_OK;
+				continue;
+			}
+			if (partiel)
+			{
+				v.code = lireZonePNM(copies[n].c_str(), ligne0, ligne1 - ligne0, 0, e.largeur, copie, &entetecopie);
+				if (v.code == PNM_OK && (entetecopie.largeur != e.largeur || entetecopie.hauteur != e.hauteur || entetecopie.canaux != e.canaux))
+				{
+					v.code = PNM_ERREUR_DONNEES;
+				}
+				if (v.code == PNM_ERREUR_FORMAT)
+				{
+					// Copie en ASCII : on la lit en entier et on garde la bande
+					v.code = lirePNM(copies[n].c_str(), copie);
+					if (v.code == PNM_OK && (copie.entete.largeur != e.largeur || copie.entete.hauteur != e.hauteur || copie.entete.canaux != e.canaux))
+					{
+						v.code = PNM_ERREUR_DONNEES;
+					}
+					if (v.code == PNM_OK)
+					{
+						size_t parligne = (size_t)e.largeur * e.canaux;
+						copie.donnees.erase(copie.donnees.begin() + ligne1 * parligne, copie.donnees.end());
+						copie.donnees.erase(copie.donnees.begin(), copie.donnees.begin() + ligne0 * parligne);
+					}
+				}
+			}
+			else
+			{
+				v.code = lirePNM(copies[n].c_str(), copie);
+				if (v.code == PNM_OK && (copie.entete.largeur != e.largeur || copie.entete.hauteur != e.hauteur || copie.entete.canaux != e.canaux))
+				{
+					v.code = PNM_ERREUR_DONNEES;
+				}
+			}
+			if (v.code == PNM_OK)
+			{
+				decoderChainesCopie(orig, copie, debutbande, positions, v.textes);
+			}
+		}
+	};
+	vector<thread> threads;
+	for (int t = 1; t < nbthreads; t++)
+	{
+		threads.push_back(thread(travail));
+	}
+	travail();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+
+	if (!rapport.empty())
+	{
+		ofstream f(rapport.c_str());
+		if (f.fail())
+		{
+			cout << "Impossible d'ecrire le rapport " << rapport << endl;
+			return PNM_ERREUR_OUVERTURE;
+		}
+		f << "# copie";
+		for (size_t p = 0; p < positions.size(); p++)
+		{
+			f << "\t(" << positions[p].x << ',' << positions[p].y << ',' << positions[p].canal << ')';
+		}
+		f << "\terreur\n";
+		for (size_t n = 0; n < resultats.size(); n++)
+		{
+			const VerificationCopie &v = resultats[n];
+			f << v.fichier;
+			for (size_t p = 0; p < positions.size(); p++)
+			{
+				f << '\t';
+				if (v.code != PNM_OK)
+				{
+					f << '-';
+					continue;
+				}
+				// Les octets non imprimables sont crits en hexadcimal pour garder une ligne par copie
+				for (size_t c = 0; c < v.textes[p].size(); c++)
+				{
+					unsigned char o = (unsigned char)v.textes[p][c];
+					if (o >= 32 && o < 127 && o != '\\')
+					{
+						f << (char)o;
+					}
+					else
+					{
+						char hex[8];
+						snprintf(hex, sizeof(hex), "\\x%02x", o);
+						f << hex;
+					}
+				}
+			}
+			f << '\t' << (v.code == PNM_OK ? "-" : messageErreurPNM(v.code)) << '\n';
 		}
-		retr += tmpr;
-		retg += tmpg;
-		retb += tmpb;
 	}
-	retr *= alphaDCT(starti, 8) * alphaDCT(startj, 8);
-	retg *= alphaDCT(starti, 8) * alphaDCT(startj, 8);
-	retb *= alphaDCT(starti, 8) * alphaDCT(startj, 8);
-	ret.red = (unsigned char)retr;
-	ret.green = (unsigned char)retg;
-	ret.blue = (unsigned char)retb;
-	return ret;
+	return PNM_OK;
 }
 
-// Calcule la DCT entire et remplace l'image par celle-ci (PPM) (TP1)
-// Ne marche pas
-void dctPPM(PPMImage *image)
+// Tampon de lecture du chargeur en lot : le contenu brut d'un fichier, rutilis d'un fichier  l'autre
+typedef struct {
+	size_t indice;
+	int code;
+	vector<unsigned char> octets;
+	size_t taille;
+} TamponChargement;
+
+// Agrandit le tampon  la taille du fichier (taille ngative : taille inconnue). Renvoie PNM_OK, PNM_ERREUR_FORMAT ou PNM_ERREUR_MEMOIRE
+static int dimensionnerTampon(TamponChargement &tampon, long long taille)
 {
-	PPMPixel tmp;
-	for (int i = 0; i < image->x; i++)
+	if (taille <= 0)
 	{
-		for (int j = 0; j < image->y; j++)
+		return PNM_ERREUR_FORMAT;
+	}
+	if ((unsigned long long)taille > (unsigned long long)((size_t)-1))
+	{
+		return PNM_ERREUR_MEMOIRE;
+	}
+	try
+	{
+		if (tampon.octets.size() < (size_t)taille)
 		{
-			tmp = dctBlocPPM(image, i, j);
-			image->data[i * image->x + j].red = tmp.red;
-			image->data[i * image->x + j].green = tmp.green;
-			image->data[i * image->x + j].blue = tmp.blue;
+			tampon.octets.resize((size_t)taille);
 		}
 	}
-	return;
+	catch (const bad_alloc &)
+	{
+		return PNM_ERREUR_MEMOIRE;
+	}
+	tampon.taille = (size_t)taille;
+	return PNM_OK;
 }
 
-// Met les bits d'une image gris dans un pixel d'image de couleur en dcoupant un octet en 3 parties, 3, 3 et 2 qui sont mises dans les bits de poids faibles du pixel (Exercice 1)
-void dissimulationPGMdansPPM(PPMImage *im_rvb, unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols)
+// Lit tout un fichier dans un tampon par lectures positionnes (pread sous Linux), sans passer par le tampon de stdio
+static int lireFichierComplet(const char *filename, TamponChargement &tampon)
 {
-	if ((rows != im_rvb->x) || (cols != im_rvb->y))
+	FILE *fp;
+	if (fopen_s(&fp, filename, "rb") != 0 || !fp)
 	{
-		cout << "Erreur, les deux images ne sont pas de la meme taille. La fonction a ete annulee." << endl;
-		return;
+		return PNM_ERREUR_OUVERTURE;
 	}
-	unsigned char tmp1, tmp2, tmp3;
-	
-	for (int i = 0; i < im_rvb->x; i++)
+	setvbuf(fp, NULL, _IONBF, 0);
+	int r = dimensionnerTampon(tampon, tailleFichier(fp));
+	if (r == PNM_OK && !lireAPosition(fp, 0, &tampon.octets[0], tampon.taille))
 	{
-		for (int j = 0; j < im_rvb->y; j++)
-		{
-			// A cause de l'optimisation de compilateur (je suppose?) il faut sparer les lignes pour que ce soit bien des 0 qui remplacent les anciens bits
-			tmp1 = im_gris[i][j] << 5;
-			tmp1 = tmp1 >> 5;
-			tmp2 = im_gris[i][j] << 2;
-			tmp2 = tmp2 >> 5;
-			tmp3 = im_gris[i][j] >> 6;
-
-			// Pareil que juste avant
-			im_rvb->data[i * im_rvb->x + j].red = im_rvb->data[i * im_rvb->x + j].red >> 3;
-			im_rvb->data[i * im_rvb->x + j].red = im_rvb->data[i * im_rvb->x + j].red << 3;
-			im_rvb->data[i * im_rvb->x + j].red = im_rvb->data[i * im_rvb->x + j].red | tmp1;
-			im_rvb->data[i * im_rvb->x + j].green = im_rvb->data[i * im_rvb->x + j].green >> 3;
-			im_rvb->data[i * im_rvb->x + j].green = im_rvb->data[i * im_rvb->x + j].green << 3;
-			im_rvb->data[i * im_rvb->x + j].green = im_rvb->data[i * im_rvb->x + j].green | tmp2;
-			im_rvb->data[i * im_rvb->x + j].blue = im_rvb->data[i * im_rvb->x + j].blue >> 2;
-			im_rvb->data[i * im_rvb->x + j].blue = im_rvb->data[i * im_rvb->x + j].blue << 2;
-			im_rvb->data[i * im_rvb->x + j].blue = im_rvb->data[i * im_rvb->x + j].blue | tmp3;
-		}
+		r = PNM_ERREUR_DONNEES;
 	}
-	return;
+	fclose(fp);
+	return r;
 }
 
-// Sort les bits d'une image gris  partir d'une image de couleur en rcuprant les bits de poids faibles dans les composantes de couleurs (Exercice 1)
-void extractionPGMdePPM(PPMImage *im_rvb, unsigned char im_gris[MAXROWS][MAXCOLS])
+#ifdef TATOUAGE_IO_URING
+// Anneau io_uring : file de soumission et file de compltion partages avec le noyau (projetes en mmoire)
+typedef struct {
+	int fd;
+	unsigned *sqtete, *sqqueue, *sqmasque, *sqtableau;
+	unsigned *cqtete, *cqqueue, *cqmasque;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq, *cq;
+	size_t taillesq, taillecq, taillesqes;
+} AnneauLecture;
+
+static void fermerAnneauLecture(AnneauLecture &a)
 {
-	unsigned char tmp1, tmp2, tmp3;
+	if (a.sq != MAP_FAILED)
+	{
+		munmap(a.sq, a.taillesq);
+	}
+	if (a.cq != MAP_FAILED)
+	{
+		munmap(a.cq, a.taillecq);
+	}
+	if ((void *)a.sqes != MAP_FAILED)
+	{
+		munmap(a.sqes, a.taillesqes);
+	}
+	close(a.fd);
+}
 
-	for (int i = 0; i < im_rvb->x; i++)
+// Vrai si le noyau connat les oprations dont le chargeur a besoin (ouverture, taille et lecture)
+static bool sonderAnneauLecture(AnneauLecture &a)
+{
+	size_t taille = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+	vector<unsigned char> memoire(taille, 0);
+	struct io_uring_probe *sonde = (struct io_uring_probe *)&memoire[0];
+	if (syscall(__NR_io_uring_register, a.fd, IORING_REGISTER_PROBE, sonde, 256) < 0)
 	{
-		for (int j = 0; j < im_rvb->y; j++)
+		return false;
+	}
+	const int operations[3] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READV };
+	for (int i = 0; i < 3; i++)
+	{
+		if (operations[i] > sonde->last_op || !(sonde->ops[operations[i]].flags & IO_URING_OP_SUPPORTED))
 		{
-			tmp1 = im_rvb->data[i * im_rvb->x + j].red << 5;
-			tmp1 = tmp1 >> 5;
-			tmp2 = im_rvb->data[i * im_rvb->x + j].green << 5;
-			tmp2 = tmp2 >> 2;
-			tmp3 = im_rvb->data[i * im_rvb->x + j].blue << 6;
-
-			im_gris[i][j] = tmp1 | tmp2 | tmp3;
+			return false;
 		}
 	}
-	return;
+	return true;
 }
 
-// Dissimule un texte dans une image en niveau de gris en dcoupant les bits (Exercice 2)
-void dissimulationTexteDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int k, string texteacacher)
+// Cre un anneau d'au moins entrees places. Renvoie faux si le noyau ne le permet pas (trop ancien, io_uring dsactiv, filtre seccomp,
+// ouverture ou taille de fichier impossibles par l'anneau)
+static bool ouvrirAnneauLecture(AnneauLecture &a, unsigned entrees)
 {
-	if (texteacacher.size() > (cols * rows) / 4)
-	{
-		cout << "Chaine de caractere trop longue par rapport a l image" << endl;
-		return;
-	}
-	else if (k < 0)
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	a.fd = (int)syscall(__NR_io_uring_setup, entrees, &p);
+	if (a.fd < 0)
 	{
-		cout << "Constante ne peut etre negative" << endl;
-		return;
+		return false;
 	}
-	else if (k > (rows - 4 * sqrt(texteacacher.size())))
+	a.taillesq = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	a.taillecq = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	a.taillesqes = p.sq_entries * sizeof(struct io_uring_sqe);
+	a.sq = mmap(NULL, a.taillesq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a.fd, IORING_OFF_SQ_RING);
+	a.cq = mmap(NULL, a.taillecq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a.fd, IORING_OFF_CQ_RING);
+	a.sqes = (struct io_uring_sqe *)mmap(NULL, a.taillesqes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a.fd, IORING_OFF_SQES);
+	if (a.sq == MAP_FAILED || a.cq == MAP_FAILED || (void *)a.sqes == MAP_FAILED)
 	{
-		cout << "Constante trop grande pour rentrer toute la chaine de caractere" << endl;
-		return;
+		fermerAnneauLecture(a);
+		return false;
 	}
-	else if (texteacacher[texteacacher.size() - 1] != '*')
+	char *sq = (char *)a.sq, *cq = (char *)a.cq;
+	a.sqtete = (unsigned *)(sq + p.sq_off.head);
+	a.sqqueue = (unsigned *)(sq + p.sq_off.tail);
+	a.sqmasque = (unsigned *)(sq + p.sq_off.ring_mask);
+	a.sqtableau = (unsigned *)(sq + p.sq_off.array);
+	a.cqtete = (unsigned *)(cq + p.cq_off.head);
+	a.cqqueue = (unsigned *)(cq + p.cq_off.tail);
+	a.cqmasque = (unsigned *)(cq + p.cq_off.ring_mask);
+	a.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	if (!sonderAnneauLecture(a))
 	{
-		cout << "La chaine de caracteres doit finir par *" << endl;
-		return;
+		fermerAnneauLecture(a);
+		return false;
 	}
+	return true;
+}
 
-	unsigned char tmp1, tmp2, tmp3, tmp4;
-	int compteur = 0;
+// Prpare la prochaine entre de la file de soumission ; publierEntreeAnneau la rend visible au noyau. Un seul thread soumet
+static struct io_uring_sqe *entreeAnneau(AnneauLecture &a, int operation, int fd, unsigned long long donnee)
+{
+	struct io_uring_sqe *sqe = &a.sqes[*a.sqqueue & *a.sqmasque];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = (unsigned char)operation;
+	sqe->fd = fd;
+	sqe->user_data = donnee;
+	return sqe;
+}
 
-	for (int i = k + 2 * sqrt(texteacacher.size()); i < k + 4 * sqrt(texteacacher.size()) && compteur < texteacacher.size(); i++)
-	{
-		for (int j = k + 2 * sqrt(texteacacher.size()); j < k + 4 * sqrt(texteacacher.size()) && compteur < texteacacher.size(); j += 4)
-		{
-			// A cause de l'optimisation de compilateur (je suppose?) il faut sparer les lignes pour que ce soit bien des 0 qui remplacent les anciens bits
-			tmp1 = (unsigned char) texteacacher[compteur] << 6;
-			tmp1 = tmp1 >> 6;
-			tmp2 = (unsigned char) texteacacher[compteur] << 4;
-			tmp2 = tmp2 >> 6;
-			tmp3 = (unsigned char) texteacacher[compteur] << 2;
-			tmp3 = tmp3 >> 6;
-			tmp4 = (unsigned char) texteacacher[compteur] >> 6;
-			compteur++;
+// L'entre prpare part au prochain attendreAnneau
+static void publierEntreeAnneau(AnneauLecture &a)
+{
+	unsigned queue = *a.sqqueue;
+	unsigned indice = queue & *a.sqmasque;
+	a.sqtableau[indice] = indice;
+	__atomic_store_n(a.sqqueue, queue + 1, __ATOMIC_RELEASE);
+}
 
-			// Pareil que juste avant
-			im_gris[i][j] = im_gris[i][j] >> 2;
-			im_gris[i][j] = im_gris[i][j] << 2;
-			im_gris[i][j] = im_gris[i][j] | tmp1;
+// Ouverture en lecture seule ; le rsultat est le descripteur ou -errno
+static void soumettreOuvertureAnneau(AnneauLecture &a, const char *filename, unsigned long long donnee)
+{
+	struct io_uring_sqe *sqe = entreeAnneau(a, IORING_OP_OPENAT, AT_FDCWD, donnee);
+	sqe->addr = (unsigned long long)(uintptr_t)filename;
+	sqe->open_flags = O_RDONLY | O_CLOEXEC;
+	publierEntreeAnneau(a);
+}
 
-			im_gris[i][j + 1] = im_gris[i][j + 1] >> 2;
-			im_gris[i][j + 1] = im_gris[i][j + 1] << 2;
-			im_gris[i][j + 1] = im_gris[i][j + 1] | tmp2;
+// Taille du fichier par son nom, envoye en mme temps que son ouverture
+static void soumettreTailleAnneau(AnneauLecture &a, const char *filename, struct statx *etat, unsigned long long donnee)
+{
+	struct io_uring_sqe *sqe = entreeAnneau(a, IORING_OP_STATX, AT_FDCWD, donnee);
+	sqe->addr = (unsigned long long)(uintptr_t)filename;
+	sqe->len = STATX_SIZE;
+	sqe->off = (unsigned long long)(uintptr_t)etat;
+	publierEntreeAnneau(a);
+}
 
-			im_gris[i][j + 2] = im_gris[i][j + 2] >> 2;
-			im_gris[i][j + 2] = im_gris[i][j + 2] << 2;
-			im_gris[i][j + 2] = im_gris[i][j + 2] | tmp3;
+static void soumettreLectureAnneau(AnneauLecture &a, int fd, struct iovec *vecteur, unsigned long long position, unsigned long long donnee)
+{
+	struct io_uring_sqe *sqe = entreeAnneau(a, IORING_OP_READV, fd, donnee);
+	sqe->addr = (unsigned long long)(uintptr_t)vecteur;
+	sqe->len = 1;
+	sqe->off = position;
+	publierEntreeAnneau(a);
+}
 
-			im_gris[i][j + 3] = im_gris[i][j + 3] >> 2;
-			im_gris[i][j + 3] = im_gris[i][j + 3] << 2;
-			im_gris[i][j + 3] = im_gris[i][j + 3] | tmp4;
+// Soumet les lectures en attente et attend qu'au moins une soit termine. Renvoie faux si le noyau refuse l'appel
+static bool attendreAnneau(AnneauLecture &a)
+{
+	while (true)
+	{
+		unsigned asoumettre = *a.sqqueue - __atomic_load_n(a.sqtete, __ATOMIC_ACQUIRE);
+		if (syscall(__NR_io_uring_enter, a.fd, asoumettre, 1, IORING_ENTER_GETEVENTS, NULL, 0) >= 0)
+		{
+			return true;
+		}
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			return false;
 		}
 	}
-	return;
 }
 
-// Extrait un texte d'une image de niveau de gris (Exercice 2)
-void extractionTexteDepuisPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int k, int nbcarac, string &textearecup)
+// Appelle fin(donnee, resultat) pour chaque lecture termine
+template <typename Fin> static void reprendreAnneau(AnneauLecture &a, Fin fin)
 {
-	unsigned char tmp1, tmp2, tmp3, tmp4;
-	int compteur = 0;
-	textearecup.resize(nbcarac);
-	for (int i = k + 2 * sqrt(nbcarac); i < k + 4 * sqrt(nbcarac) && compteur < nbcarac; i++)
+	unsigned tete = *a.cqtete;
+	while (tete != __atomic_load_n(a.cqqueue, __ATOMIC_ACQUIRE))
 	{
-		for (int j = k + 2 * sqrt(nbcarac); j < k + 4 * sqrt(nbcarac) && compteur < nbcarac; j += 4)
-		{
-			// A cause de l'optimisation de compilateur (je suppose?) il faut sparer les lignes pour que ce soit bien des 0 qui remplacent les anciens bits
-			tmp1 = im_gris[i][j] << 6;
-			tmp1 = tmp1 >> 6;
-			tmp2 = im_gris[i][j + 1] << 6;
-			tmp2 = tmp2 >> 4;
-			tmp3 = im_gris[i][j + 2] << 6;
-			tmp3 = tmp3 >> 2;
-			tmp4 = im_gris[i][j + 3] << 6;
-
-			textearecup[compteur] = tmp1 | tmp2 | tmp3 | tmp4;
-			compteur++;
-		}
+		const struct io_uring_cqe *cqe = &a.cqes[tete & *a.cqmasque];
+		unsigned long long donnee = cqe->user_data;
+		int resultat = cqe->res;
+		tete++;
+		__atomic_store_n(a.cqtete, tete, __ATOMIC_RELEASE);
+		fin(donnee, resultat);
 	}
-	return;
 }
 
-// Fonction qui renvoie 1 si le bit du caractre est gal  1 et -1 s'il est gal  0 (Exercice 3)
-int wByte(int x, string texte)
+// Ouvre un fichier et agrandit le tampon  sa taille sans passer par l'anneau, quand celui-ci tombe en panne (mmes codes que lireFichierComplet)
+static int preparerLectureAnneau(const char *filename, TamponChargement &tampon, int &fd)
 {
-	int entier = x / 8;
-	int reste = x % 8;
-	unsigned char tmp = texte[entier];
-	tmp = tmp >> (7 - reste);
-	tmp = tmp << 7;
-	if (tmp == (unsigned char)128)
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
 	{
-		return 1;
+		return PNM_ERREUR_OUVERTURE;
 	}
-	else
+	struct stat s;
+	int r = fstat(fd, &s) != 0 ? PNM_ERREUR_FORMAT : dimensionnerTampon(tampon, (long long)s.st_size);
+	if (r != PNM_OK)
 	{
-		return -1;
+		close(fd);
+		fd = -1;
 	}
+	return r;
 }
+#endif
 
-// Dissimule une chaine de 8 caractres dans une image de niveau de gris (Exercice 3)
-void dissimulationChaineCaracDansPGM(unsigned char im_gris[MAXROWS][MAXCOLS], long rows, long cols, int a, int x, int y, string texteacacher)
+// Charge une liste d'images PNM en lot : nblecteurs threads ouvrent et lisent les fichiers en avance pendant que nbthreads threads
+// (sous Linux avec io_uring, un seul thread garde nblecteurs fichiers en cours d'ouverture ou de lecture dans l'anneau et les threads de lecture
+// ne servent qu'en secours)
+// dcodent les tampons dj lus et appellent traitement(image, indice, code) ; code est PNM_OK ou l'erreur de lecture ou de dcodage du fichier indice
+// Au plus nbenvol fichiers lus attendent d'tre dcods, ce qui borne la mmoire ; les tampons et les images sont rutiliss
+// Les fichiers sont traits dans l'ordre o ils finissent d'tre lus. Renvoie le nombre d'images dcodes sans erreur
+template <typename Traitement> long chargerImagesEnLot(const vector<string> &fichiers, int nblecteurs, int nbthreads, int nbenvol, Traitement traitement)
 {
-	if (x + 8 >= cols || y + 8 >= rows)
+	int nbcoeurs = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	if (nbthreads <= 0)
 	{
-		cout << "Debut du carre trop loin par rapport  la taille de l'image" << endl;
-		return;
+		nbthreads = nbcoeurs;
 	}
-	else if (x < 0 || y < 0)
+	if (nblecteurs <= 0)
 	{
-		cout << "En dehors de l'image" << endl;
-		return;
+		// Les lecteurs passent leur temps  attendre le disque : plusieurs lectures en cours par coeur gardent la file du disque pleine
+		nblecteurs = 2 * nbcoeurs;
 	}
-	if (a == 0)
+	if (nbenvol < nblecteurs + nbthreads)
 	{
-		cout << "Constante ne doit pas etre nulle" << endl;
-		return;
+		nbenvol = nblecteurs + nbthreads;
 	}
 
-	int tmp;
-	for (int i = x; i < x + 8; i++)
+	vector<TamponChargement> tampons(nbenvol);
+	deque<int> libres, lus;
+	for (int k = 0; k < nbenvol; k++)
 	{
-		for (int j = y; j < y + 8; j++)
+		libres.push_back(k);
+	}
+	mutex verrou;
+	condition_variable signal;
+	atomic<size_t> prochain(0);
+	int lecteursactifs = nblecteurs;
+	atomic<long> correctes(0);
+
+	auto lecture = [&]()
+	{
+		size_t n;
+		while ((n = prochain.fetch_add(1)) < fichiers.size())
 		{
-			tmp = (im_gris[i][j] + a * wByte((i - x) * 8 + (j - y), texteacacher));
-			if (tmp > 255)
+			int k;
 			{
-				im_gris[i][j] = 255;
+				unique_lock<mutex> l(verrou);
+				signal.wait(l, [&]() { return !libres.empty(); });
+				k = libres.front();
+				libres.pop_front();
 			}
-			else if (tmp < 0)
+			tampons[k].indice = n;
+			tampons[k].taille = 0;
+			tampons[k].code = lireFichierComplet(fichiers[n].c_str(), tampons[k]);
+			lock_guard<mutex> l(verrou);
+			lus.push_back(k);
+			signal.notify_all();
+		}
+		lock_guard<mutex> l(verrou);
+		lecteursactifs--;
+		signal.notify_all();
+	};
+
+	bool avecanneau = false;
+#ifdef TATOUAGE_IO_URING
+	// Chaque fichier occupe au plus deux entres de l'anneau  la fois (ouverture et taille, puis une lecture)
+	int profondeur = min(nblecteurs, 2048);
+	AnneauLecture anneau;
+	avecanneau = ouvrirAnneauLecture(anneau, (unsigned)(2 * profondeur));
+	vector<int> descripteurs(nbenvol, -1);
+	vector<struct iovec> vecteurs(nbenvol);
+	vector<size_t> dejalus(nbenvol, 0);
+	vector<struct statx> etats(nbenvol);
+	vector<int> preparations(nbenvol, 0);
+	vector<char> actifs(nbenvol, 0);
+	auto lectureAnneau = [&]()
+	{
+		// Le bas de donnee distingue les oprations d'un mme tampon : 0 lecture, 1 ouverture, 2 taille
+		const unsigned long long LECTURE = 0, OUVERTURE = 1, TAILLE = 2;
+		int encours = 0, fichiersencours = 0;
+		bool panne = false;
+		// Le tampon k est lu (ou en erreur) : il passe aux threads de dcodage
+		auto terminer = [&](int k, int code)
+		{
+			if (descripteurs[k] >= 0)
 			{
-				im_gris[i][j] = 0;
+				close(descripteurs[k]);
+				descripteurs[k] = -1;
+			}
+			actifs[k] = 0;
+			fichiersencours--;
+			tampons[k].code = code;
+			lock_guard<mutex> l(verrou);
+			lus.push_back(k);
+			signal.notify_all();
+		};
+		// Lit la suite du fichier du tampon k, par morceaux de 1 Go au plus (le rsultat d'une lecture tient dans un int)
+		// Si l'anneau est en panne, la lecture se termine ici par pread
+		auto soumettre = [&](int k)
+		{
+			while (panne && dejalus[k] < tampons[k].taille)
+			{
+				ssize_t n = pread(descripteurs[k], &tampons[k].octets[dejalus[k]], tampons[k].taille - dejalus[k], (off_t)dejalus[k]);
+				if (n <= 0 && !(n < 0 && errno == EINTR))
+				{
+					terminer(k, PNM_ERREUR_DONNEES);
+					return;
+				}
+				dejalus[k] += n > 0 ? n : 0;
+			}
+			if (panne)
+			{
+				terminer(k, PNM_OK);
+				return;
+			}
+			vecteurs[k].iov_base = &tampons[k].octets[dejalus[k]];
+			vecteurs[k].iov_len = min(tampons[k].taille - dejalus[k], (size_t)1 << 30);
+			soumettreLectureAnneau(anneau, descripteurs[k], &vecteurs[k], dejalus[k], 4 * (unsigned long long)k + LECTURE);
+			encours++;
+		};
+		// Ouverture et taille du tampon k connues : le tampon est agrandi puis la lecture part
+		auto prepare = [&](int k)
+		{
+			int code = tampons[k].code;
+			if (code == PNM_OK)
+			{
+				code = dimensionnerTampon(tampons[k], (long long)etats[k].stx_size);
+			}
+			if (code != PNM_OK)
+			{
+				terminer(k, code);
 			}
 			else
 			{
-				im_gris[i][j] = tmp;
+				soumettre(k);
+			}
+		};
+		// Sans l'anneau, l'ouverture se fait ici
+		auto preparerSansAnneau = [&](int k)
+		{
+			int code = preparerLectureAnneau(fichiers[tampons[k].indice].c_str(), tampons[k], descripteurs[k]);
+			if (code != PNM_OK)
+			{
+				terminer(k, code);
+			}
+			else
+			{
+				soumettre(k);
+			}
+		};
+		size_t n = 0;
+		while (n < fichiers.size() || fichiersencours > 0)
+		{
+			while (n < fichiers.size() && fichiersencours < profondeur)
+			{
+				int k;
+				{
+					unique_lock<mutex> l(verrou);
+					if (libres.empty() && fichiersencours > 0)
+					{
+						break;
+					}
+					signal.wait(l, [&]() { return !libres.empty(); });
+					k = libres.front();
+					libres.pop_front();
+				}
+				tampons[k].indice = n++;
+				tampons[k].taille = 0;
+				tampons[k].code = PNM_OK;
+				dejalus[k] = 0;
+				actifs[k] = 1;
+				fichiersencours++;
+				if (panne)
+				{
+					preparerSansAnneau(k);
+					continue;
+				}
+				// L'ouverture et la taille partent ensemble ; la lecture attend les deux
+				const char *nom = fichiers[tampons[k].indice].c_str();
+				etats[k].stx_size = 0;
+				preparations[k] = 2;
+				soumettreOuvertureAnneau(anneau, nom, 4 * (unsigned long long)k + OUVERTURE);
+				soumettreTailleAnneau(anneau, nom, &etats[k], 4 * (unsigned long long)k + TAILLE);
+				encours += 2;
+			}
+			if (encours == 0)
+			{
+				continue;
 			}
+			if (!attendreAnneau(anneau))
+			{
+				// Le noyau refuse l'anneau en cours de route : les fichiers en cours sont repris par open et pread
+				// (un descripteur ouvert par l'anneau sans que sa compltion soit lue est perdu jusqu' la fin du processus)
+				panne = true;
+				encours = 0;
+				for (int k = 0; k < nbenvol; k++)
+				{
+					if (!actifs[k])
+					{
+						continue;
+					}
+					if (preparations[k] > 0)
+					{
+						preparations[k] = 0;
+						if (descripteurs[k] >= 0)
+						{
+							close(descripteurs[k]);
+							descripteurs[k] = -1;
+						}
+						preparerSansAnneau(k);
+					}
+					else
+					{
+						soumettre(k);
+					}
+				}
+				continue;
+			}
+			reprendreAnneau(anneau, [&](unsigned long long donnee, int resultat)
+			{
+				int k = (int)(donnee / 4);
+				unsigned long long operation = donnee % 4;
+				encours--;
+				if (operation != LECTURE)
+				{
+					if (operation == OUVERTURE && resultat >= 0)
+					{
+						descripteurs[k] = resultat;
+					}
+					else if (operation == OUVERTURE)
+					{
+						tampons[k].code = PNM_ERREUR_OUVERTURE;
+					}
+					else if (resultat < 0 && tampons[k].code == PNM_OK)
+					{
+						tampons[k].code = PNM_ERREUR_FORMAT;
+					}
+					if (--preparations[k] == 0)
+					{
+						prepare(k);
+					}
+				}
+				else if (resultat == -EINTR || resultat == -EAGAIN)
+				{
+					soumettre(k);
+				}
+				else if (resultat <= 0)
+				{
+					terminer(k, PNM_ERREUR_DONNEES);
+				}
+				else if ((dejalus[k] += resultat) < tampons[k].taille)
+				{
+					soumettre(k);
+				}
+				else
+				{
+					terminer(k, PNM_OK);
+				}
+			});
+		}
+		lock_guard<mutex> l(verrou);
+		lecteursactifs--;
+		signal.notify_all();
+	};
+#endif
+
+	auto travail = [&]()
+	{
+		ImagePNM16 image;
+		while (true)
+		{
+			int k;
+			{
+				unique_lock<mutex> l(verrou);
+				signal.wait(l, [&]() { return !lus.empty() || lecteursactifs == 0; });
+				if (lus.empty())
+				{
+					return;
+				}
+				k = lus.front();
+				lus.pop_front();
+			}
+			size_t indice = tampons[k].indice;
+			int code = tampons[k].code;
+			if (code == PNM_OK)
+			{
+				code = decoderPNM(&tampons[k].octets[0], tampons[k].taille, image);
+			}
+			// Le tampon est rendu avant le traitement pour que les lecteurs continuent pendant le marquage
+			{
+				lock_guard<mutex> l(verrou);
+				libres.push_back(k);
+				signal.notify_all();
+			}
+			if (code == PNM_OK)
+			{
+				correctes++;
+			}
+			traitement(image, indice, code);
 		}
+	};
+
+	vector<thread> threads;
+#ifdef TATOUAGE_IO_URING
+	if (avecanneau)
+	{
+		lecteursactifs = 1;
+		threads.push_back(thread(lectureAnneau));
 	}
-	return;
+#endif
+	for (int t = 0; !avecanneau && t < nblecteurs; t++)
+	{
+		threads.push_back(thread(lecture));
+	}
+	for (int t = 1; t < nbthreads; t++)
+	{
+		threads.push_back(thread(travail));
+	}
+	travail();
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+#ifdef TATOUAGE_IO_URING
+	if (avecanneau)
+	{
+		fermerAnneauLecture(anneau);
+	}
+#endif
+	return correctes;
 }
 
-// Extrait une chaine de 8 caractres cache dans une image  partir de l'image originale et de la nouvelle image (Exercice 3)
-void extractionChaineCaracDansPGM(unsigned char im_gris_orig[MAXROWS][MAXCOLS], unsigned char im_gris_modif[MAXROWS][MAXCOLS], long rows, long cols, int a, int x, int y, string &textearecup)
+// Vrification interne (tatouage --verification) : chaque contrle affiche OK ou ECHEC ; renvoie le nombre d'checs
+static int controle(const char *nom, bool reussi)
 {
-	if (x + 8 >= cols || y + 8 >= rows)
+	cout << (reussi ? "OK     " : "ECHEC  ") << nom << endl;
+	return reussi ? 0 : 1;
+}
+
+// Codec PNM : encodage puis dcodage d'images P5, P6 sur 16 bits et P7, et refus d'un fichier tronqu
+static int verifierCodecPNM()
+{
+	int echecs = 0;
+	const int canaux[3] = { 1, 3, 4 };
+	const int maxvals[3] = { 255, 65535, 1023 };
+	for (int c = 0; c < 3; c++)
 	{
-		cout << "Debut du carre trop loin par rapport  la taille de l'image" << endl;
-		return;
+		ImagePNM16 image, relue;
+		image.entete.format = canaux[c] == 1 ? 5 : (canaux[c] == 3 ? 6 : 7);
+		image.entete.largeur = 37;
+		image.entete.hauteur = 21;
+		image.entete.canaux = canaux[c];
+		image.entete.maxval = maxvals[c];
+		image.entete.typetuple = canaux[c] == 4 ? "RGB_ALPHA" : "";
+		image.donnees.resize((size_t)37 * 21 * canaux[c]);
+		for (size_t n = 0; n < image.donnees.size(); n++)
+		{
+			image.donnees[n] = (unsigned short)aleatoireBorne(0xC0DEC, n, (unsigned long long)maxvals[c] + 1);
+		}
+		char tampon[256];
+		vector<unsigned char> octets;
+		MorceauEcriture morceaux[2];
+		encoderPNM(image, tampon, octets, morceaux);
+		vector<unsigned char> fichier((const unsigned char *)morceaux[0].debut, (const unsigned char *)morceaux[0].debut + morceaux[0].taille);
+		fichier.insert(fichier.end(), (const unsigned char *)morceaux[1].debut, (const unsigned char *)morceaux[1].debut + morceaux[1].taille);
+		int r = decoderPNM(&fichier[0], fichier.size(), relue);
+		echecs += controle(c == 0 ? "codec PNM : P5 8 bits" : (c == 1 ? "codec PNM : P6 16 bits" : "codec PNM : P7 4 composantes"),
+			r == PNM_OK && relue.entete.largeur == 37 && relue.entete.hauteur == 21 && relue.entete.canaux == canaux[c]
+			&& relue.entete.maxval == maxvals[c] && relue.entete.typetuple == image.entete.typetuple && relue.donnees == image.donnees);
+		echecs += controle("codec PNM : fichier tronque refuse", decoderPNM(&fichier[0], fichier.size() - 1, relue) != PNM_OK);
 	}
-	else if (x < 0 || y < 0)
+	return echecs;
+}
+
+// Reed-Solomon : nbparite / 2 octets faux sont corrigs, au-del la charge est refuse (le CRC carte une correction errone)
+static int verifierReedSolomon()
+{
+	int echecs = 0;
+	const int nbdonnees = 200, nbparite = 16;
+	unsigned char donnees[nbdonnees], code[nbdonnees + nbparite], abime[nbdonnees + nbparite];
+	for (int i = 0; i < nbdonnees; i++)
 	{
-		cout << "En dehors de l'image" << endl;
-		return;
+		donnees[i] = (unsigned char)aleatoire64(0x5EED, i);
+	}
+	encoderRS(donnees, nbdonnees, nbparite, code);
+	memcpy(abime, code, sizeof(code));
+	echecs += controle("Reed-Solomon : mot intact", decoderRS(abime, nbdonnees + nbparite, nbparite) == 0 && memcmp(abime, code, sizeof(code)) == 0);
+	for (int e = 0; e < nbparite / 2; e++)
+	{
+		abime[e * 27 % (nbdonnees + nbparite)] ^= (unsigned char)(e + 1);
 	}
+	echecs += controle("Reed-Solomon : 8 octets faux corriges", decoderRS(abime, nbdonnees + nbparite, nbparite) == nbparite / 2 && memcmp(abime, code, sizeof(code)) == 0);
 
-	int tmp;
-	unsigned char tmpbit, tmptot;
-	textearecup.resize(8);
+	string texte = "Charge protegee par Reed-Solomon et CRC-32*", charge, relu;
+	encoderCharge(texte, nbparite, charge);
+	for (int e = 0; e < nbparite / 2; e++)
+	{
+		charge[e * 5] ^= 0x55;
+	}
+	echecs += controle("Reed-Solomon : charge corrigee", decoderCharge(charge, texte.size(), nbparite, relu) == nbparite / 2 && relu == texte);
+	charge[nbparite / 2 * 5] ^= 0x55;
+	echecs += controle("Reed-Solomon : charge trop abimee refusee", decoderCharge(charge, texte.size(), nbparite, relu) < 0);
+	return echecs;
+}
 
-	for (int i = x; i < x + 8; i++)
+// Philox4x32-10 : vecteurs de rfrence de Random123, et mme suite quel que soit le dcoupage de remplirAleatoire
+static int verifierPhilox()
+{
+	int echecs = 0;
+	const unsigned long long cles[3] = { 0, ~0ULL, 0x299f31d0a4093822ULL };
+	const unsigned long long compteurs[3] = { 0, ~0ULL, 0x85a308d3243f6a88ULL };
+	const unsigned long long flux[3] = { 0, ~0ULL, 0x0370734413198a2eULL };
+	const unsigned attendus[3][4] = {
+		{ 0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u },
+		{ 0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu },
+		{ 0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u } };
+	for (int v = 0; v < 3; v++)
 	{
-		tmptot = (unsigned char)0;
-		for (int j = y; j < y + 8; j++)
+		unsigned b[4];
+		philox4x32(cles[v], compteurs[v], flux[v], b);
+		echecs += controle(v == 0 ? "Philox : vecteur de reference 0" : (v == 1 ? "Philox : vecteur de reference 1" : "Philox : vecteur de reference pi"),
+			memcmp(b, attendus[v], sizeof(b)) == 0);
+	}
+	unsigned entier[23], morceaux[23];
+	remplirAleatoire(0xC1E, 7, 5, entier, 23);
+	remplirAleatoire(0xC1E, 7, 5, morceaux, 6);
+	remplirAleatoire(0xC1E, 7, 11, morceaux + 6, 17);
+	echecs += controle("Philox : remplissage par tranches", memcmp(entier, morceaux, sizeof(entier)) == 0);
+	return echecs;
+}
+
+// Dissimulation rversible : le texte est relu et l'image restaure  l'identique
+static int verifierReversible()
+{
+	const long rows = 64, cols = 96;
+	vector<unsigned char> memoire(2 * sizeof(unsigned char[MAXROWS][MAXCOLS]), 0);
+	unsigned char (*im)[MAXCOLS] = (unsigned char (*)[MAXCOLS])&memoire[0];
+	unsigned char (*orig)[MAXCOLS] = im + MAXROWS;
+	// Dgrad bruit : les niveaux hauts restent vides
+	for (long i = 0; i < rows; i++)
+	{
+		for (long j = 0; j < cols; j++)
 		{
-			tmp = (int) ((im_gris_modif[i][j] - im_gris_orig[i][j]) / a);
-			if (tmp < 0)
-			{
-				tmpbit = (unsigned char)0;
-			}
-			else
-			{
-				tmpbit = (unsigned char)1;
-			}
-			tmpbit = tmpbit << (7 - (j - y));
-			tmptot = tmptot | tmpbit;
+			im[i][j] = orig[i][j] = (unsigned char)(60 + (i + j) / 8 + aleatoireBorne(0x2EF, i * cols + j, 4));
 		}
-		textearecup[i - x] = tmptot;
 	}
-	return;
+	string texte = "verification reversible*", relu;
+	int pic, zero;
+	int r = dissimulationReversibleDansPGM(im, rows, cols, texte, pic, zero);
+	bool modifiee = memcmp(&memoire[0], orig, sizeof(unsigned char[MAXROWS][MAXCOLS])) != 0;
+	extractionReversibleDepuisPGM(im, rows, cols, pic, zero, relu);
+	return controle("reversible : texte relu et image restauree",
+		r == 1 && modifiee && relu == texte && memcmp(&memoire[0], orig, sizeof(unsigned char[MAXROWS][MAXCOLS])) == 0);
+}
+
+// Tuiles : CRC-32 de rfrence, relecture d'une tuile crite et refus d'une tuile altre
+static int verifierTuiles()
+{
+	int echecs = 0;
+	echecs += controle("CRC-32 : valeur de reference", crc32Octets((const unsigned char *)"123456789", 9) == 0xCBF43926u);
+	FILE *fp = tmpfile();
+	if (!fp)
+	{
+		return echecs + controle("tuiles : fichier temporaire", false);
+	}
+	EnteteTuiles e;
+	initialiserEnteteTuiles(e, 70, 40, 3, 65535, 32);
+	ImagePNM16 tuile, relue;
+	tuile.donnees.resize((size_t)32 * 32 * 3);
+	for (size_t n = 0; n < tuile.donnees.size(); n++)
+	{
+		tuile.donnees[n] = (unsigned short)aleatoire64(0x7E1E, n);
+	}
+	bool ecrit = ecrireEnteteTuiles(fp, e) && ecrireTuile(fp, e, 2, 1, tuile) == PNM_OK;
+	EnteteTuiles lue;
+	echecs += controle("tuiles : tuile relue", ecrit && lireEnteteTuiles(fp, lue) == PNM_OK && lireTuile(fp, lue, 2, 1, relue) == PNM_OK && relue.donnees == tuile.donnees);
+	unsigned char octet = 0xA5;
+	echecs += controle("tuiles : tuile alteree refusee", ecrireAPosition(fp, (long long)e.positions[1 * e.nbtuilesx + 2] + 100, &octet, 1)
+		&& lireTuile(fp, lue, 2, 1, relue) == PNM_ERREUR_DONNEES);
+	fclose(fp);
+	return echecs;
 }
 
-int main()
+int verificationInterne()
 {
+	int echecs = verifierCodecPNM() + verifierReedSolomon() + verifierPhilox() + verifierReversible() + verifierTuiles();
+	if (echecs)
+	{
+		cout << "Verification : " << echecs << " echec(s)" << endl;
+	}
+	else
+	{
+		cout << "Verification : aucun echec" << endl;
+	}
+	return echecs;
+}
+
+// tatouage --verification lance les contrles internes sans rien demander
+int main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--verification") == 0)
+	{
+		return verificationInterne() == 0 ? 0 : 1;
+	}
 	long rows, cols;
 	int debutcarre1, debutcarre2, taillecarres, a, x, y;
 	char nomfich[20];
@@ -659,29 +6141,41 @@ int main()
 	unsigned char photo[MAXROWS][MAXCOLS];
 	unsigned char photo2[MAXROWS][MAXCOLS];
 	PPMImage *image;
+	// Les images marques sont enregistres dans l'index des empreintes sous le nom o elles seront crites
+	IndexationMarquage indexationpgm = { "empreintes.idx", "testpgm.pgm" };
+	IndexationMarquage indexationppm = { "empreintes.idx", "testppm.ppm" };
 	cout << "Nom du fichier pgm :";
 	cin >> nomfich;
-	readPGM(nomfich, rows, cols, photo);
+	if (!readPGM(nomfich, rows, cols, photo))
+	{
+		system("pause");
+		return 1;
+	}
 
 	cout << "Nom du fichier ppm :";
 	cin >> nomfich;
 	image = readPPM(nomfich);
+	if (!image)
+	{
+		system("pause");
+		return 1;
+	}
 	
 	/*
-	patchworkPGM(image, rows, cols, debutcarre1, debutcarre2, taillecarres);
+	patchworkPGM(image, rows, cols, 0x5EC2E7ULL, debutcarre1, debutcarre2, taillecarres, NULL, &indexationpgm);
 	cout << "debut carre 1 :\t" << debutcarre1 << endl;
 	cout << "debut carre 2 :\t" << debutcarre2 << endl;
 	cout << "taille des carres :\t" << taillecarres << endl;
 	*/
 	//dctPGM(image, rows, cols);
 	
-	dissimulationPGMdansPPM(image, photo, rows, cols);
+	dissimulationPGMdansPPM(image, photo, rows, cols, &indexationppm);
 	extractionPGMdePPM(image, photo2);
 	
 	/*
 	cout << "Chaine de caracteres a cacher sans espace qui finit par * :";
 	cin >> texteacacher;
-	dissimulationTexteDansPGM(photo, rows, cols, 0, texteacacher);
+	dissimulationTexteDansPGM(photo, rows, cols, 0, texteacacher, &indexationpgm);
 	extractionTexteDepuisPGM(photo, rows, cols, 0, texteacacher.size(), textearecup);
 	cout << "Voici la chaine recuperee :" << textearecup << endl;
 	*/
@@ -694,7 +6188,7 @@ int main()
 	cout << "Constante a (pas trop grande ( < 10 serait le plus appropri ) :";
 	cin >> a;
 	memcpy(photo2, photo, sizeof(photo));
-	dissimulationChaineCaracDansPGM(photo, rows, cols, a, x, y, texteacacher);
+	dissimulationChaineCaracDansPGM(photo, rows, cols, a, x, y, texteacacher, NULL, &indexationpgm);
 	extractionChaineCaracDansPGM(photo2, photo, rows, cols, a, x, y, textearecup);
 	cout << "Voici la chaine recupere :" << textearecup << endl;
 	*/